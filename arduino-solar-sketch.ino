@@ -1,4 +1,5 @@
 #define ARDUINO_APP
+#define AUTOMATION_PROFILING // remove to compile out GET,STATS counters
 #define VERSION "SOLAR-1.47"
 #define BUILD_NUMBER 2
 #define BUILD_DATE __DATE__
@@ -17,6 +18,7 @@
 #include "automation/constraint/ValueConstraint.h"
 #include "automation/constraint/TimeRangeConstraint.h"
 #include "automation/constraint/AndConstraint.h"
+#include "automation/constraint/ConstraintEventJournal.h"
 #include "automation/sensor/Sensor.cpp"
 #include "automation/device/Device.cpp"
 #include "automation/capability/Capability.cpp"
@@ -33,9 +35,11 @@ using namespace automation;
 #include "arduino/VoltageSensor.h"
 #include "arduino/CurrentSensor.h"
 #include "arduino/PowerSensor.h"
+#include "arduino/EnergySensor.h"
 #include "arduino/CoolingFan.h"
 #include "arduino/PowerSwitch.h"
 #include "arduino/CommandProcessor.h"
+#include "arduino/SerialTx.h"
 #include "arduino/Eeprom.h"
 #include "arduino/Automation.cpp"
 
@@ -74,6 +78,10 @@ vector<Sensor*> mainAndBankBDelta { &batteryBankVoltage, &batteryBankBVoltage };
 CompositeSensor batteryBankAVoltage(PMSTR("Bank A Voltage"), mainAndBankBDelta, Sensor::delta);
 CurrentSensor batteryBankCurrent(PMSTR("Bank Current"));
 PowerSensor batteryBankPower(PMSTR("Battery Bank Power"), &batteryBankVoltage, &batteryBankCurrent);
+EnergySensor batteryBankChargeAh(PMSTR("Bank Charge Ah"), batteryBankPower.energyMeter, EnergySensor::CHARGE_AMP_HOURS),
+             batteryBankDischargeAh(PMSTR("Bank Discharge Ah"), batteryBankPower.energyMeter, EnergySensor::DISCHARGE_AMP_HOURS),
+             batteryBankChargeWh(PMSTR("Bank Charge Wh"), batteryBankPower.energyMeter, EnergySensor::CHARGE_WATT_HOURS),
+             batteryBankDischargeWh(PMSTR("Bank Discharge Wh"), batteryBankPower.energyMeter, EnergySensor::DISCHARGE_WATT_HOURS);
 vector<Sensor*> chargerGrpSensors { &charger1Temp, &charger2Temp };
 CompositeSensor chargerGroupTemp(PMSTR("Chargers Temp"), chargerGrpSensors, Sensor::maximum);
 vector<Sensor*> enclosureGrpSensors { &enclosureTempDht, &enclosureTemp };
@@ -155,6 +163,7 @@ Devices devices {{
 Sensors sensors {{
     &chargerGroupTemp,
     &batteryBankVoltage, &batteryBankCurrent, &batteryBankPower,
+    &batteryBankChargeAh, &batteryBankDischargeAh, &batteryBankChargeWh, &batteryBankDischargeWh,
     &batteryBankAVoltage, &batteryBankBVoltage,
     &enclosureTemp, &enclosureGroupTemp, //&atticTemp, 
     &enclosureTempDht, &enclosureHumidityDht,
@@ -165,6 +174,22 @@ Sensors sensors {{
     &outlet1Switch.toggleSensor, &outlet2Switch.toggleSensor//, &lightLevel
   }};
 
+// JSON response in progress.  loop() writes one chunk per pass (CommandProcessor::step()) so sampling and
+// constraint evaluation keep running while a long response is transmitted.
+JsonStreamWriter responseWriter(serialTxPrinter);
+CommandProcessor responseProcessor(responseWriter, sensors, devices);
+unsigned int responseRequestId = 0;
+bool bResponding = false;
+
+// Runs while a response chunk waits for the transmit ring to drain.  Only work that is safe in the middle
+// of a chunk: sampling, publishing epochs and constraint evaluation wait for loop().
+void serviceWhileTransmitting() {
+  if ( !arduino::watchdog::resetRequested ) {
+    arduino::watchdog::keepAlive();
+  }
+  sensors.poll();
+}
+
 void setup() {
 
   //unsigned long serialSpeed = 38400;
@@ -172,9 +197,26 @@ void setup() {
   unsigned int serialConfig = SERIAL_8O1;
   //unsigned int serialConfig = SERIAL_8N1;
 
+  // 60 values at most every 15 seconds covers the 15 minute window
+  batteryBankVoltage.enableHistory(60, 15);
+  batteryBankCurrent.enableHistory(60, 15);
+
+  // Sample count follows noise within sensors.sampleBudgetMs.  Scanned and oversampled analog pins
+  // take one foreground sample and DHT samples within an epoch share one reading so only the
+  // ADS1115 current sensor gains from more samples.
+  batteryBankCurrent.bAdaptiveSampling = true;
+
+  // 14 bit voltage readings (10 bit steps are about 0.05V at 24V)
+  batteryBankVoltage.oversampleBits = 4;
+  batteryBankBVoltage.oversampleBits = 4;
+
   enclosureFan.minTemp.setFailDelayMs(5*MINUTES);
   inverterFan.minTemp.setFailDelayMs(3*MINUTES);
+  enclosureFan.setPredictive(true); // start when the temperature trend reaches onTemp within 5 minutes
+  inverterFan.setPredictive(true);
   //chargerGroupFan.minTemp.setFailDelayMs(5*MINUTES);
+
+  ConstraintEventJournal::instance(); // start recording before EEPROM commands can change results
   
   String version;
   eeprom.getVersion(version);
@@ -210,10 +252,37 @@ void setup() {
     pDevice->setup();
   }
 
+  arduino::adcScanner.start(); // analog sensors registered their pins during setup
+
+  sensors.getValuesBySampling(); // first epoch blocks so commands always have published values
+
+  serialTx.setIdleHandler(serviceWhileTransmitting);
   arduino::watchdog::enable();
   commandBuff[0] = '\0';
 }
 
+void printResponseBegin(JsonStreamWriter& writer, unsigned int requestId) {
+  writer.clearByteCount();
+  writer.clearChecksum();
+  writer.implPrint(F("#BEGIN:"));
+  writer.implPrint(requestId);
+  writer.implPrintln("#");
+}
+
+void printResponseEnd(JsonStreamWriter& writer, unsigned int requestId) {
+  writer.implPrint(F("\n#END:"));
+  writer.implPrint(requestId);
+  writer.implPrint(":");
+  writer.implPrint(writer.getByteCount());
+  writer.implPrint(":");
+  writer.implPrint(writer.getChecksum());
+  writer.implPrint(":");
+  writer.implPrint(automation::isTimeValid()?1:0);
+  writer.implPrint(":");
+  writer.implPrint(eeprom.getDeviceId());
+  writer.implPrintln("#");
+}
+
 void loop() {
   static unsigned long lastUpdateTimeMs = 0, beginCmdReadTimeMs = 0;
   static unsigned int updateIntervalMs = 15000;
@@ -224,8 +293,11 @@ void loop() {
   bool msgReadTimedOut = false;
   unsigned long currentTimeMs = millis();
 
+  serialTx.pump(); // tail of the previous response
+
   // read char by char to avoid issues with default 64 byte serial buffer
-  while (Serial.available() ) {
+  // (the next command waits in Serial until the response in progress is complete)
+  while ( !bResponding && Serial.available() ) {
     char c = Serial.read();
     if ( bytesRead == 0 ) {
       if ( c == -1 )
@@ -247,19 +319,26 @@ void loop() {
 
   if ( (cmdReady && strlen(commandBuff)) || (currentTimeMs - lastUpdateTimeMs) > updateIntervalMs )
   {
-    sensors.reset(); // clear cached values
-    sensors.getValuesBySampling(); // save time by sampling in parallel
-    
+    sensors.beginSampling(); // samples are taken across loop() calls so commands are not blocked
+    lastUpdateTimeMs = millis();
+  } else if ( beginCmdReadTimeMs > 0 && (currentTimeMs - beginCmdReadTimeMs) > updateIntervalMs ) {
+    msgReadTimedOut = true;
+  }
+
+  sensors.poll();
+  TimerWheel::instance().advance(); // constraint deferrals and remote expirations that are due
+
+  bool bSampled = sensors.sampleTick(); // true when all sensors are sampled and the new values are published
+  if ( bSampled || Constraints::isEvaluationRequested() ) {
+    Constraints::isEvaluationRequested() = false;
     if ( !Constraints::isPaused() ) {      
+      Constraints::beginEvaluation(); // constraints shared by devices are tested once
       for (Device* pDevice : devices) {
         bool bIgnoreSameResult = false; // this will override remote changes if constraint mode is not REMOTE
         pDevice->applyConstraint(bIgnoreSameResult);
       }
+      Constraints::endEvaluation();
     }
-    
-    lastUpdateTimeMs = millis();
-  } else if ( beginCmdReadTimeMs > 0 && (currentTimeMs - beginCmdReadTimeMs) > updateIntervalMs ) {
-    msgReadTimedOut = true;
   }
 
   if ( cmdReady || msgReadTimedOut ) {
@@ -268,59 +347,70 @@ void loop() {
     char *pszRequestId = strtok(NULL, "|");
     unsigned int requestId = atoi(pszRequestId);
 
-    JsonSerialWriter writer;
-    writer.clearByteCount();
-    writer.clearChecksum();
-    writer.implPrint(F("#BEGIN:"));
-    writer.implPrint(requestId);
-    writer.implPrintln("#");
-    writer.println( "[" );
-    writer.increaseDepth();
-    CommandProcessor cmdProcessor(writer, sensors, devices);
-
-    if ( msgReadTimedOut )
-    {
-      writer.println("{");
-      cmdProcessor.beginResp();
-      writer + F("Serial data read timed out.  Bytes received: ") + bytesRead;
-      if ( bytesRead == 1 ) {
-        writer + F(". First byte: ") + ((int)commandBuff[0]);
-      }
-      cmdProcessor.endResp(101);
-      writer.println("}");
-    }
-    else if ( msgSizeExceeded )
+    if ( cmdReady && pszCmd && CommandProcessor::isTelemetryCommand(pszCmd) )
     {
-      writer.println("{");
-      cmdProcessor.beginResp();
-      writer + F("Request exceeded maximum size. Bytes read: ") + bytesRead;
-      cmdProcessor.endResp(102);
-      writer.println("}");
+      BinaryFrameWriter writer(serialTxPrinter, json::jsonFormat == JsonFormat::BINARY_FLOAT);
+      printResponseBegin(writer, requestId);
+      arduino::watchdog::keepAlive();
+      automation::client::watchdog::messageReceived();
+      writer.printFrame(sensors);
+      printResponseEnd(writer, requestId);
     }
     else
     {
-      arduino::watchdog::keepAlive();
-      automation::client::watchdog::messageReceived();
-      cmdProcessor.execute(pszCmd);
+      JsonStreamWriter& writer = responseWriter;
+      writer.depth = 0;
+      printResponseBegin(writer, requestId);
+      writer.println( "[" );
+      writer.increaseDepth();
+      CommandProcessor& cmdProcessor = responseProcessor;
+
+      if ( msgReadTimedOut )
+      {
+        writer.println("{");
+        cmdProcessor.beginResp();
+        writer + F("Serial data read timed out.  Bytes received: ") + bytesRead;
+        if ( bytesRead == 1 ) {
+          writer + F(". First byte: ") + ((int)commandBuff[0]);
+        }
+        cmdProcessor.endResp(101);
+        writer.println("}");
+      }
+      else if ( msgSizeExceeded )
+      {
+        writer.println("{");
+        cmdProcessor.beginResp();
+        writer + F("Request exceeded maximum size. Bytes read: ") + bytesRead;
+        cmdProcessor.endResp(102);
+        writer.println("}");
+      }
+      else
+      {
+        arduino::watchdog::keepAlive();
+        automation::client::watchdog::messageReceived();
+        cmdProcessor.begin(pszCmd); // commandBuff is not read again until the response is complete
+      }
+      responseRequestId = requestId;
+      bResponding = true;
     }
 
-    writer.decreaseDepth();
-    writer.print("]");
-    writer.implPrint(F("\n#END:"));
-    writer.implPrint(requestId);
-    writer.implPrint(":");
-    writer.implPrint(writer.getByteCount());
-    writer.implPrint(":");
-    writer.implPrint(writer.getChecksum());
-    writer.implPrint(":");
-    writer.implPrint(automation::isTimeValid()?1:0);
-    writer.implPrint(":");
-    writer.implPrint(eeprom.getDeviceId());
-    writer.implPrintln("#");
-
     bytesRead = 0; // reset commandBuff
     beginCmdReadTimeMs = 0;
   }
 
+  // Next chunk of the response once the ring has room for it
+  if ( bResponding && serialTx.isHalfEmpty() && !responseProcessor.step() ) {
+    responseWriter.decreaseDepth();
+    responseWriter.print("]");
+    printResponseEnd(responseWriter, responseRequestId);
+    bResponding = false;
+  }
+
+  if ( arduino::watchdog::resetRequested ) {
+    if ( bResponding ) {
+      return; // rest of the response first
+    }
+    serialTx.drain(); // keepAlive() blocks until the watchdog resets the board
+  }
   arduino::watchdog::keepAlive();
 }
@@ -0,0 +1,83 @@
+#ifndef ARDUINO_ADC_SCANNER_H
+#define ARDUINO_ADC_SCANNER_H
+
+#include "../automation/sensor/AnalogScanner.h"
+
+namespace arduino {
+
+  // Free running ADC driven by the conversion complete interrupt.  Each conversion result is handed to
+  // AnalogScanner and the next conversion is started from the ISR so no foreground time is spent waiting.
+  class AdcScanner : public automation::AnalogScanner {
+  public:
+
+    // analogRead() and readVcc() take over the ADC so scanning must be paused around them
+    struct Pause {
+      AdcScanner& scanner;
+      Pause(AdcScanner& scanner) : scanner(scanner) { scanner.pause(); }
+      ~Pause() { scanner.resume(); }
+    };
+
+    static uint8_t toChannel(uint8_t pin) {
+      return pin >= A0 ? pin - A0 : pin;
+    }
+
+    bool isRunning() const { return bRunning && pauseCnt == 0; }
+
+    void start() {
+      if ( bRunning || getChannelCnt() == 0 ) {
+        return;
+      }
+      bRunning = true;
+      ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0); // 16MHz/128 same as arduino core
+      startConversion(getCurrentChannel());
+    }
+
+    void pause() {
+      if ( bRunning && pauseCnt++ == 0 ) {
+        ADCSRA &= ~_BV(ADIE);
+        while (bit_is_set(ADCSRA,ADSC)); // let conversion in progress finish
+        ADCSRA |= _BV(ADIF); // clear pending interrupt
+      }
+    }
+
+    void resume() {
+      if ( bRunning && pauseCnt > 0 && --pauseCnt == 0 ) {
+        resetVisit();
+        ADCSRA |= _BV(ADIE);
+        startConversion(getCurrentChannel());
+      }
+    }
+
+    // Blocking read for pins that are not scanned
+    int analogRead(uint8_t pin) {
+      Pause pause(*this);
+      return ::analogRead(pin);
+    }
+
+    static void startConversion(uint8_t channel) {
+      ADMUX = _BV(REFS0) | (channel & 0x07); // AVcc reference (DEFAULT)
+#if defined(MUX5)
+      if ( channel & 0x08 ) {
+        ADCSRB |= _BV(MUX5);
+      } else {
+        ADCSRB &= ~_BV(MUX5);
+      }
+#endif
+      ADCSRA |= _BV(ADSC);
+    }
+
+  protected:
+    bool bRunning = false;
+    uint8_t pauseCnt = 0;
+  };
+
+  AdcScanner adcScanner;
+
+}
+
+ISR(ADC_vect) {
+  uint16_t value = ADC;
+  arduino::AdcScanner::startConversion(arduino::adcScanner.conversionComplete(value));
+}
+
+#endif
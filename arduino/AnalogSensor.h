@@ -2,11 +2,18 @@
 #define ANALOG_SENSOR_H
 
 #include "ArduinoSensor.h"
+#include "AdcScanner.h"
 
 
 class AnalogSensor : public ArduinoSensor {
 public:
 
+  static const uint8_t MAX_OVERSAMPLE_BITS = 4;
+
+  // Extra bits of resolution (0 to disable).  Each value decimates 4^n conversions to 10+n bits.  This
+  // only works if ADC noise is at least 1 LSB (dither) which is normal for the high impedance dividers.
+  uint8_t oversampleBits = 0;
+
   AnalogSensor(const char* const name, uint8_t sensorPin, uint16_t sampleCnt=1, uint16_t sampleIntervalMs=25)
       : ArduinoSensor(name,sensorPin,sampleCnt,sampleIntervalMs) {
   }
@@ -14,12 +21,85 @@ public:
   void setup() override {
     if ( !isInitialized() ) {
       pinMode(sensorPin, INPUT);
+      adcScanner.addChannel(AdcScanner::toChannel(sensorPin));
       setInitialized(true);
     }
   }
 
+  bool isScanned() const {
+    return adcScanner.isRunning() && adcScanner.hasChannel(AdcScanner::toChannel(sensorPin));
+  }
+
+  // Scanned and oversampled pins already average many conversions so one foreground sample is enough
+  uint16_t getSampleCnt() const override {
+    return isScanned() || oversampleBits ? 1 : Sensor::getSampleCnt();
+  }
+
+  uint16_t getOversampleCnt() const {
+    return 1 << (2*oversampleBits);
+  }
+
   float getValueImpl() const override {
-    return analogRead(sensorPin);
+    return readAnalog();
+  }
+
+  // Average ADC value from the scanner or a single analogRead() if the pin is not scanned
+  float readAnalog() const {
+    if ( oversampleBits ) {
+      return readOversampled();
+    }
+    float average;
+    if ( isScanned() && adcScanner.takeAverage(AdcScanner::toChannel(sensorPin), average) ) {
+      return average;
+    }
+    return adcScanner.analogRead(sensorPin);
+  }
+
+  // Conversions accumulated by the scanner are used first and topped up with back to back reads (no
+  // sleeps) if there are fewer than 4^n.  Returned in 10 bit ADC units with n fractional bits.
+  float readOversampled() const {
+    uint32_t sum = 0;
+    uint16_t cnt = 0;
+    if ( isScanned() ) {
+      adcScanner.take(AdcScanner::toChannel(sensorPin), sum, cnt);
+    }
+    uint16_t requiredCnt = getOversampleCnt();
+    if ( cnt < requiredCnt ) {
+      AdcScanner::Pause pause(adcScanner);
+      ::analogRead(sensorPin); // dropped while sample and hold settles after changing channel
+      while ( cnt < requiredCnt ) {
+        sum += ::analogRead(sensorPin);
+        cnt++;
+      }
+    }
+    uint32_t decimated = ((sum << oversampleBits) + cnt/2) / cnt;
+    return (float) decimated / (1 << oversampleBits);
+  }
+
+  void printVerboseExtra(JsonStreamWriter& w) const override {
+    w.printlnNumberObj(F("oversampleBits"),oversampleBits,",");
+  }
+
+  virtual SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream = nullptr) override {
+    SetCode rtn = ArduinoSensor::setAttribute(pszKey,pszVal,pRespStream);
+    if ( rtn == SetCode::OK && !strcasecmp_P(pszKey, PSTR("sensorPin")) ) {
+      adcScanner.addChannel(AdcScanner::toChannel(sensorPin));
+    } else if ( rtn == SetCode::Ignored && !strcasecmp_P(pszKey, PSTR("oversampleBits")) ) {
+      uint8_t bits = atoi(pszVal);
+      if ( bits > MAX_OVERSAMPLE_BITS ) {
+        if ( pRespStream ) {
+          (*pRespStream) << pszKey << F(" must be 0 to ") << (int) MAX_OVERSAMPLE_BITS;
+        }
+        rtn = SetCode::Error;
+      } else {
+        oversampleBits = bits;
+        rtn = SetCode::OK;
+        if ( pRespStream ) {
+          (*pRespStream) << "'" << name << "' " << pszKey << "=" << pszVal;
+        }
+      }
+    }
+    return rtn;
   }
 };
 
@@ -3,6 +3,8 @@
 
 #include <Time.h>
 
+#include "AdcScanner.h"
+
 namespace arduino {
   const float Vref = 5.0;  //TODO read from mega board
 
@@ -10,6 +12,7 @@ namespace arduino {
   String gLastInfoMsg;
   
   long readVcc() {
+    AdcScanner::Pause pauseScanner(adcScanner);
     // Read 1.1V reference against AVcc
     // set the reference to Vcc and the measurement to the internal 1.1V reference
 #if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
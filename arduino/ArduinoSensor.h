@@ -21,8 +21,8 @@ public:
   {
   }
 
-  void reset() override { 
-    automation::Sensor::reset();
+  void resetStatus() override { 
+    automation::Sensor::resetStatus();
     status.reset(); 
   }
 
@@ -38,6 +38,14 @@ public:
       } else if ( !strcasecmp_P(pszKey, PSTR("sampleIntervalMs")) ) {
         sampleIntervalMs = atoi(pszVal);
         rtn = SetCode::OK;
+      } else if ( !strcasecmp_P(pszKey, PSTR("adaptiveSampling")) ) {
+        bAdaptiveSampling = text::parseBool(pszVal);
+        adaptiveSampleCnt = 0;
+        lastEpochMean = NAN;
+        rtn = SetCode::OK;
+      } else if ( !strcasecmp_P(pszKey, PSTR("sampleTolerance")) ) {
+        sampleTolerance = atof(pszVal);
+        rtn = SetCode::OK;
       }
       if (pRespStream && rtn == SetCode::OK ) {
         (*pRespStream) << "'" << name << "' " << pszKey << "=" << pszVal;
@@ -56,6 +64,12 @@ public:
       w.printlnNumberObj(F("sensorPin"),sensorPin,",");
       w.printlnNumberObj(F("sampleCnt"),sampleCnt,",");
       w.printlnNumberObj(F("sampleIntervalMs"),sampleIntervalMs,",");
+      w.printlnNumberObj(F("effectiveSampleCnt"),getSampleCnt(),",");
+      w.printlnNumberObj(F("effectiveSampleMs"),(unsigned long) getSampleCnt()*sampleIntervalMs,",");
+      if ( bAdaptiveSampling ) {
+        w.printlnNumberObj(F("sampleTolerance"),sampleTolerance,",");
+        w.printlnNumberObj(F("sampleStdDev"),sqrt(sampleVariance),",");
+      }
       w.printlnStringObj(F("type"),getType(),",");
       printVerboseExtra(w);
     }
@@ -15,6 +15,10 @@ namespace automation {
     return millis();
   }
 
+  unsigned long microsecs() {
+    return micros();
+  }
+
   void sleep(unsigned long intervalMs) {
     delay(intervalMs);
   }
@@ -5,12 +5,18 @@
 #include "Arduino.h"
 #include "../automation/json/JsonStreamWriter.h"
 #include "../automation/json/json.h"
+#include "../automation/json/BinaryFrameWriter.h"
 #include "Eeprom.h"
+#include "EnergySensor.h"
 
+#include "../automation/LocalTime.h"
+#include "../automation/Profiler.h"
+#include "../automation/constraint/ConstraintEventJournal.h"
 #include "../automation/capability/Capability.h"
 #include "watchdog.h"
 
 #include <vector>
+#include <iterator>
 #include <map>
 #include <string>
 
@@ -61,6 +67,23 @@ namespace arduino {
       return CMD_OK;
     }
 
+    // With a BINARY jsonFormat a plain GET,SENSORS is answered with a telemetry frame instead of JSON
+    static bool isTelemetryCommand(const char *pszCmd) {
+      if ( !isBinary() || strncasecmp_P(pszCmd, PSTR("GET"), 3) || (pszCmd[3] != ',' && pszCmd[3] != ' ') ) {
+        return false;
+      }
+      pszCmd += 4;
+      if ( strncasecmp_P(pszCmd, PSTR("SENSORS"), 7) ) {
+        return false;
+      }
+      for ( pszCmd += 7; *pszCmd; pszCmd++ ) {
+        if ( !isspace(*pszCmd) ) {
+          return false;
+        }
+      }
+      return true;
+    }
+
     JsonStreamWriter &beginResp() {
       writer.beginStringObj(F("respMsg"));
       return writer;
@@ -71,7 +94,7 @@ namespace arduino {
         writer + (respCode == 0 ? F("OK") : F("ERROR"));
       }
       writer.endStringObj(",");
-      writer.noPrefixPrintln("");
+      writer.noPrefixPrintln();
 
       if ( gLastErrorMsg.length() )
       {
@@ -90,56 +113,156 @@ namespace arduino {
       return writer;
     }
 
+    // Blocking version of begin()/step()
     int execute(char *pszScript) {
-      int cmdResult = 0;
-      int cmdCnt = 0;
+      begin(pszScript);
+      while ( step() ) {
+      }
+      return respCode;
+    }
 
-      size_t scriptLen = strlen(pszScript);
-      char *pszCmd = strtok(pszScript, ";\r\n");
-      size_t nextIndex = 0;
+    // A response is written over several loop() passes so sampling and constraint evaluation keep running
+    // while it is transmitted.  begin() takes the script (commands separated by ';') and each step() writes
+    // one chunk: a command, one GET argument or one item of a listing.  Returns false when the response is
+    // complete.  The script must not change until then.
+    void begin(char *pszScript) {
+      this->pszScript = pszScript;
+      scriptLen = strlen(pszScript);
+      nextIndex = 0;
+      cmdCnt = 0;
+      respCode = 0;
+    }
 
-      while (pszCmd) {
-        int cmdLen = strlen(pszCmd); // need length before strtok alters content
-        if ( cmdCnt++ > 0 ) {
-          writer.noPrefixPrintln(",");
-        }
-        int cmdResult = executeLine(pszCmd);
-        if (cmdResult) {
-          break;
-        }
-        nextIndex += cmdLen + 1;
-        if ( nextIndex >= scriptLen ) {
-          break;
-        } else {
-          pszCmd = strtok(&pszScript[nextIndex], ";\r\n");
+    bool step() {
+      if ( lineState != LineState::Done ) {
+        PROFILE_SCOPE(*pCommandProfile) // calls are chunks so maxUs is the longest loop() pass
+        continueLine();
+        return true;
+      }
+      if ( !pszScript ) {
+        return false;
+      }
+      char *pszCmd = (respCode == 0 && nextIndex < scriptLen) ? strtok(&pszScript[nextIndex], ";\r\n") : nullptr;
+      if ( !pszCmd ) {
+        writer.println();
+        pszScript = nullptr;
+        std::vector<AttributeContainer*>().swap(foundVec); // heap only used while the response is written
+        std::vector<unsigned long>().swap(historyIds);
+        return false;
+      }
+      nextIndex = (pszCmd - pszScript) + strlen(pszCmd) + 1; // need length before strtok alters content
+      if ( cmdCnt++ > 0 ) {
+        writer.noPrefixPrintln(",");
+      }
+      beginLine(pszCmd);
+      return true;
+    }
+
+    // Blocking, used for the EEPROM setup script
+    int executeLine(char *pszCmd) {
+      beginLine(pszCmd);
+      while ( lineState != LineState::Done ) {
+        continueLine();
+      }
+      return respCode;
+    }
+
+#ifdef AUTOMATION_PROFILING
+    static const uint8_t MAX_COMMAND_PROFILES = 10; // the last one counts all other commands
+
+    typedef std::pair<string,automation::profile::Counter> CommandProfile;
+
+    static vector<CommandProfile>& commandProfiles() {
+      static vector<CommandProfile> profiles;
+      if ( profiles.capacity() < MAX_COMMAND_PROFILES ) {
+        profiles.reserve(MAX_COMMAND_PROFILES); // counters are referenced while the command runs
+      }
+      return profiles;
+    }
+
+    static automation::profile::Counter& getCommandProfile(const char* pszCmdName) {
+      vector<CommandProfile>& profiles = commandProfiles();
+      string name(pszCmdName ? pszCmdName : "");
+      std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+      if ( profiles.size() >= MAX_COMMAND_PROFILES - 1 && !findCommandProfile(name) ) {
+        name = RVSTR("OTHER");
+      }
+      automation::profile::Counter* pCounter = findCommandProfile(name);
+      if ( !pCounter ) {
+        profiles.push_back(CommandProfile(name,automation::profile::Counter()));
+        pCounter = &profiles.back().second;
+      }
+      return *pCounter;
+    }
+
+    static automation::profile::Counter* findCommandProfile(const string& name) {
+      for ( CommandProfile& profile : commandProfiles() ) {
+        if ( profile.first == name ) {
+          return &profile.second;
         }
       }
-      writer.println();
-      return cmdResult;
+      return nullptr;
     }
+#endif
 
-    int executeLine(char *pszCmd,bool bVerbose=false) {
-      int respCode = 0;
+  protected:
+
+    // Command in progress.  Unprocessed GET arguments are kept as a string since other code may use strtok()
+    // between steps.  Only one listing is in progress at a time and the items listed must outlive it.
+    enum class LineState : uint8_t { Done, GetArgs, End };
+    typedef bool (CommandProcessor::*ItemPrinter)();
+    typedef const json::Printable* (*ItemAt)(const void* pItems, size_t index);
+
+    char *pszScript = nullptr;
+    size_t scriptLen = 0, nextIndex = 0;
+    int cmdCnt = 0;
+    int respCode = 0;
+    bool bVerbose = false;
+    LineState lineState = LineState::Done;
+    char *pszArgs = nullptr;
+    ItemPrinter pPrintItem = nullptr; // listing in progress
+    const void* pItems = nullptr;
+    ItemAt itemAt = nullptr;
+    size_t itemIndex = 0;
+    uint16_t printedCnt = 0;
+    AttributeContainerVector<AttributeContainer*> foundVec; // listed by FILTER and GET by ID
+    std::vector<unsigned long> historyIds;
+#ifdef AUTOMATION_PROFILING
+    automation::profile::Counter* pCommandProfile = nullptr;
+#endif
+
+    void beginLine(char *pszCmd, bool bVerbose=false) {
       //cout << __PRETTY_FUNCTION__ << " command: " << pszCmd << "." << endl;
       char *pszCmdName = strtok(pszCmd, ", ");
+#ifdef AUTOMATION_PROFILING
+      pCommandProfile = &getCommandProfile(pszCmdName);
+#endif
+      PROFILE_SCOPE(*pCommandProfile)
+      this->bVerbose = bVerbose;
+      lineState = LineState::Done;
+      respCode = 0;
       if (!strcasecmp_P(pszCmdName, PSTR("setup")) || !strcasecmp_P(pszCmdName, PSTR("eeprom"))) {
         respCode = processSetupCommand();
       } else if (!strcasecmp_P(pszCmdName, PSTR("RESET"))) {
-        arduino::watchdog::resetRequested = true;
-        beginResp() + F("Reset requested");
-        endResp(0);
+        const char* pszArg = strtok(NULL, ", \r\n");
+        if ( pszArg == nullptr ) {
+          arduino::watchdog::resetRequested = true;
+          beginResp() + F("Reset requested");
+          endResp(0);
+        } else {
+          respCode = processResetCommand(pszArg);
+        }
       } else if (!strcasecmp_P(pszCmdName, PSTR("SET"))) {
         respCode = processSetCommand();
       } else if (!strcasecmp_P(pszCmdName, PSTR("GET"))) {
-        respCode = processGetCommand(bVerbose);
+        processGetCommand();
       } else if (!strcasecmp_P(pszCmdName, PSTR("INCLUDE"))) {
-        respCode = processFilterCommand(bVerbose,true);
+        processFilterCommand(true);
       } else if (!strcasecmp_P(pszCmdName, PSTR("EXCLUDE"))) {
-        respCode = processFilterCommand(bVerbose,false);
+        processFilterCommand(false);
       } else if (!strcasecmp_P(pszCmdName, PSTR("VERBOSE"))) {
         pszCmd = strtok(NULL, "\r\n");
-        bVerbose = true;
-        respCode = executeLine(pszCmd,bVerbose);
+        beginLine(pszCmd,true);
       } else if (!strcasecmp_P(pszCmdName, PSTR("PAUSE")) || !strcasecmp_P(pszCmdName, PSTR("RESUME")) ) {
         bool bPause = !strcasecmp_P(pszCmdName, PSTR("PAUSE"));
         if ( !bPause ) {
@@ -161,33 +284,80 @@ namespace arduino {
         beginResp() + F("Expected {get|include|exclude|set|setup|eeprom|reset|verbose|pause|resume} but found: ") + (pszCmdName?pszCmdName:"");
         endResp(INVALID_ARGUMENT);
       }
-      return respCode;
     }
 
+    // Next chunk of a GET, INCLUDE or EXCLUDE
+    void continueLine() {
+      if ( pPrintItem ) {
+        if ( !(this->*pPrintItem)() ) {
+          pPrintItem = nullptr;
+        }
+      } else if ( lineState == LineState::GetArgs ) {
+        const char *pszArg = strtok(pszArgs, ", ");
+        if ( pszArg ) {
+          processGetArg(pszArg);
+        } else {
+          lineState = LineState::End;
+        }
+      } else {
+        if (!respCode) {
+          beginResp();
+          writer + "OK";
+        }
+        endResp(respCode);
+        writer.decreaseDepth().print("}");
+        lineState = LineState::Done;
+      }
+    }
 
-  protected:
+    template<typename TItems>
+    static const json::Printable* itemAtIndex(const void* pItems, size_t index) {
+      const TItems& items = *(const TItems*) pItems;
+      return index < items.size() ? *std::next(items.begin(), index) : nullptr;
+    }
+
+    // Same output as printlnVectorObj() but the items are written by later steps
+    template<typename TKey, typename TItems>
+    void beginListing(TKey k, const TItems& items) {
+      writer.printKey(k);
+      writer.beginIterator();
+      pItems = &items;
+      itemAt = &itemAtIndex<TItems>;
+      itemIndex = 0;
+      pPrintItem = &CommandProcessor::printListedItem;
+    }
+
+    bool printListedItem() {
+      const json::Printable* pItem = itemAt(pItems, itemIndex);
+      if ( !pItem ) {
+        writer.endIterator(",");
+        writer.println();
+        return false;
+      }
+      writer.printIteratorItem(pItem, itemIndex++ == 0, bVerbose);
+      return true;
+    }
 
     ////////////
     // FILTER //
     ////////////
 
-    int processFilterCommand(bool bVerbose,bool bInclude) {
-      int respCode = 0;
+    void processFilterCommand(bool bInclude) {
       const char* pszArg = strtok(NULL, ", ");
 
       writer.println("{").increaseDepth();
 
       const char* pszNamePattern = strtok(NULL,"\r\n");
-      AttributeContainerVector<AttributeContainer*> filteredVec;
+      foundVec.clear();
 
       if (!strcasecmp_P(pszArg, PSTR("SENSORS"))) {
-        sensors.findByTitleLike(pszNamePattern,filteredVec,bInclude);
+        sensors.findByTitleLike(pszNamePattern,foundVec,bInclude);
       } else if (!strcasecmp_P(pszArg, PSTR("DEVICES"))) {
-        devices.findByTitleLike(pszNamePattern,filteredVec,bInclude);
+        devices.findByTitleLike(pszNamePattern,foundVec,bInclude);
       } else if (!strcasecmp_P(pszArg, PSTR("CONSTRAINTS"))) {
-        Constraints(Constraint::all()).findByTitleLike(pszNamePattern,filteredVec,bInclude);
+        Constraints(Constraint::all()).findByTitleLike(pszNamePattern,foundVec,bInclude);
       } else if (!strcasecmp_P(pszArg, PSTR("CAPABILITIES"))) {
-        Capabilities(Capability::all()).findByTitleLike(pszNamePattern,filteredVec,bInclude);
+        Capabilities(Capability::all()).findByTitleLike(pszNamePattern,foundVec,bInclude);
       } else {
         beginResp();
         writer + F("FILTER command expected {SENSORS|DEVICES|CONSTRAINTS|CAPABILITIES} but found: '") + pszArg + "'.";
@@ -196,22 +366,42 @@ namespace arduino {
       if (!respCode) {
         String key(pszArg);
         key.toLowerCase();
-        writer.printlnVectorObj(key, filteredVec, ",", bVerbose);
-        beginResp();
-        writer + "OK";
+        beginListing(key, foundVec);
       }
-      endResp(respCode);
+      lineState = LineState::End;
+    }
+    
+    ///////////
+    // RESET //
+    ///////////
 
+    int processResetCommand(const char* pszArg) {
+      int respCode = 0;
+      writer.println("{").increaseDepth();
+      if (!strcasecmp_P(pszArg, PSTR("ENERGY"))) {
+        for ( EnergyMeter* pMeter : EnergyMeter::all() ) {
+          pMeter->reset();
+        }
+        beginResp() + F("Energy totals reset");
+#ifdef AUTOMATION_PROFILING
+      } else if (!strcasecmp_P(pszArg, PSTR("STATS"))) {
+        resetStats();
+        beginResp() + F("Profiling counters reset");
+#endif
+      } else {
+        beginResp() + F("RESET command expected {ENERGY|STATS} or no argument but found: '") + pszArg + "'.";
+        respCode = INVALID_ARGUMENT;
+      }
+      endResp(respCode);
       writer.decreaseDepth().print("}");
       return respCode;
     }
-    
+
     /////////
     // GET //
     /////////
 
-    int processGetCommand(bool bVerbose) {
-      int respCode = 0;
+    void processGetCommand() {
       const char *pszArg = strtok(NULL, ", ");
 
       if (pszArg==nullptr) {
@@ -219,105 +409,237 @@ namespace arduino {
       }
 
       writer.println("{").increaseDepth();
-      do {
-        if (!strcasecmp_P(pszArg, PSTR("env"))) {
-          writer.printKey(F("env"));
-          writer.noPrefixPrintln("{");
-          writer.increaseDepth();
-          writer.printlnStringObj(F("version"), VERSION, ",")
-              .printlnNumberObj(F("buildNumber"), BUILD_NUMBER, ",")
-              .printlnStringObj(F("buildDate"), BUILD_DATE, ",")
-              .printlnStringObj(F("vcc"), readVcc(), ",");
-          writer.beginStringObj(F("time"));
-          time_t t = now();
-          writer + year(t) + "-" + month(t) + "-" + day(t) + " " + hour(t) + ":" + minute(t) + ":" + second(t);
-          writer.endStringObj();
-          writer.noPrefixPrintln(",");
-          writer.printlnBoolObj("timeSet", automation::isTimeValid());
-          writer.decreaseDepth();
-          writer.println("},");
-        } else if (!strcasecmp_P(pszArg, PSTR("eeprom")) || !strcasecmp_P(pszArg, PSTR("setup"))) {
-          writer.printKey(F("eeprom"));
-          eeprom.noPrefixPrint(writer);
-          writer.noPrefixPrintln(",");
-        } else if (!strcasecmp_P(pszArg, PSTR("isPaused"))) {
-          writer.printlnBoolObj(F("isPaused"), Constraints::isPaused(), ",");
-        } else if (!strcasecmp_P(pszArg, PSTR("jsonFormat"))) {
-          writer.printlnStringObj(F("jsonFormat"), formatAsString(jsonFormat).c_str(), ",");
-        } else if (!strcasecmp_P(pszArg, PSTR("SENSOR")) 
-                || !strcasecmp_P(pszArg, PSTR("DEVICE")) 
-                || !strcasecmp_P(pszArg, PSTR("CAPABILITY")) 
-                || !strcasecmp_P(pszArg, PSTR("CONSTRAINT"))) {
-          string automationType(pszArg);
-          std::transform(automationType.begin(), automationType.end(), automationType.begin(), ::tolower);
-          AttributeContainerVector<AttributeContainer*> resultVec;
-          std::vector<unsigned long> ids;
-          const char* pszId;
-          while ( (pszId=strtok(NULL, ",\r\n")) != NULL ) {
-            ids.push_back(atol(pszId));
+      processGetArg(pszArg);
+    }
+
+    // Listings (sensors, devices, history...) only write their key here and continue one item per step.
+    // EVENTS and STATS are written at once so their sequence numbers and counters are consistent.
+    void processGetArg(const char *pszArg) {
+      if (!strcasecmp_P(pszArg, PSTR("env"))) {
+        writer.printKey(F("env"));
+        writer.noPrefixPrintln("{");
+        writer.increaseDepth();
+        writer.printlnStringObj(F("version"), VERSION, ",")
+            .printlnNumberObj(F("buildNumber"), BUILD_NUMBER, ",")
+            .printlnStringObj(F("buildDate"), BUILD_DATE, ",")
+            .printlnStringObj(F("vcc"), readVcc(), ",");
+        writer.beginStringObj(F("time"));
+        time_t t = now();
+        writer + year(t) + "-" + month(t) + "-" + day(t) + " " + hour(t) + ":" + minute(t) + ":" + second(t);
+        writer.endStringObj();
+        writer.noPrefixPrintln(",");
+        writer.printlnBoolObj("timeSet", automation::isTimeValid());
+        writer.decreaseDepth();
+        writer.println("},");
+      } else if (!strcasecmp_P(pszArg, PSTR("eeprom")) || !strcasecmp_P(pszArg, PSTR("setup"))) {
+        writer.printKey(F("eeprom"));
+        eeprom.noPrefixPrint(writer);
+        writer.noPrefixPrintln(",");
+      } else if (!strcasecmp_P(pszArg, PSTR("isPaused"))) {
+        writer.printlnBoolObj(F("isPaused"), Constraints::isPaused(), ",");
+      } else if (!strcasecmp_P(pszArg, PSTR("jsonFormat"))) {
+        writer.printlnStringObj(F("jsonFormat"), formatAsString(jsonFormat).c_str(), ",");
+      } else if (!strcasecmp_P(pszArg, PSTR("SENSOR")) 
+              || !strcasecmp_P(pszArg, PSTR("DEVICE")) 
+              || !strcasecmp_P(pszArg, PSTR("CAPABILITY")) 
+              || !strcasecmp_P(pszArg, PSTR("CONSTRAINT"))) {
+        string automationType(pszArg);
+        std::transform(automationType.begin(), automationType.end(), automationType.begin(), ::tolower);
+        foundVec.clear();
+        std::vector<unsigned long> ids;
+        const char* pszId;
+        while ( (pszId=strtok(NULL, ",\r\n")) != NULL ) {
+          ids.push_back(atol(pszId));
+        }
+        if ( ids.empty() ) {
+          beginResp();
+          writer + F("ID required for GET of ") + pszArg + ".";
+          respCode = INVALID_ARGUMENT;
+        } else {
+          if( !strcasecmp_P(pszArg, PSTR("SENSOR")) ) {
+            sensors.findByIds(ids,foundVec);
+          } else if( !strcasecmp_P(pszArg, PSTR("CONSTRAINT")) ) {
+            Constraints(Constraint::all()).findByIds(ids,foundVec);
+          } else if( !strcasecmp_P(pszArg, PSTR("CAPABILITY")) ) {
+            Capabilities(Capability::all()).findByIds(ids,foundVec);
+          } else if( !strcasecmp_P(pszArg, PSTR("DEVICE")) ) {
+            devices.findByIds(ids,foundVec);
           }
-          if ( ids.empty() ) {
-            beginResp();
-            writer + F("ID required for GET of ") + pszArg + ".";
-            respCode = INVALID_ARGUMENT;
+          if ( foundVec.size() == ids.size() ) {
+            beginListing(automationType.c_str(), foundVec);
           } else {
-            if( !strcasecmp_P(pszArg, PSTR("SENSOR")) ) {
-              sensors.findByIds(ids,resultVec);
-            } else if( !strcasecmp_P(pszArg, PSTR("CONSTRAINT")) ) {
-              Constraints(Constraint::all()).findByIds(ids,resultVec);
-            } else if( !strcasecmp_P(pszArg, PSTR("CAPABILITY")) ) {
-              Capabilities(Capability::all()).findByIds(ids,resultVec);
-            } else if( !strcasecmp_P(pszArg, PSTR("DEVICE")) ) {
-              devices.findByIds(ids,resultVec);
-            }
-            if ( resultVec.size() == ids.size() ) {
-              //singletonVec[0]->printlnObj( writer, automationType.c_str(), ",", bVerbose);
-              writer.printlnVectorObj(automationType.c_str(), resultVec, ",",bVerbose);
-            } else {
-              beginResp();
-              writer + F("Expected ") + ids.size() + " " + pszArg + F(" result(s) but found ") + resultVec.size();
-              respCode = resultVec.size() < ids.size() ? NOT_FOUND : CMD_ERROR;
-            }
+            beginResp();
+            writer + F("Expected ") + ids.size() + " " + pszArg + F(" result(s) but found ") + foundVec.size();
+            respCode = foundVec.size() < ids.size() ? NOT_FOUND : CMD_ERROR;
           }
-        } else if (!strcasecmp_P(pszArg, PSTR("SENSORS"))) {
-          writer.printlnVectorObj(F("sensors"), sensors, ",",bVerbose);
-        } else if (!strcasecmp_P(pszArg, PSTR("DEVICES"))) {
-          writer.printlnVectorObj(F("devices"), devices, ",",bVerbose);
-        } else if (!strcasecmp_P(pszArg, PSTR("CONSTRAINTS"))) {
-          writer.printlnVectorObj(F("constraints"), Constraint::all(), ",",bVerbose);
-        } else if (!strcasecmp_P(pszArg, PSTR("CAPABILITIES"))) {
-          writer.printlnVectorObj(F("capabilities"), Capability::all(), ",",bVerbose);
-        } else if (!strcasecmp_P(pszArg, PSTR("TIME"))) {
-          time_t t = now();
-          writer.printKey("time");
-          writer.noPrefixPrintln("{");
-          writer.increaseDepth();
-          writer.printlnNumberObj("year", year(t), ",");
-          writer.printlnNumberObj("month", month(t), ",");
-          writer.printlnNumberObj("day", day(t), ",");
-          writer.printlnNumberObj("hour", hour(t), ",");
-          writer.printlnNumberObj("minute", minute(t), ",");
-          writer.printlnNumberObj("second", second(t), ",");
-          writer.printlnBoolObj("timeSet", automation::isTimeValid());
-          writer.decreaseDepth();
-          writer.println("},");
-        } else {
-          beginResp();
-          writer + F("get command expected {sensors|devices|jsonFormat|time|env|setup|eeprom} but found: '") + pszArg + "'.";
-          respCode = INVALID_ARGUMENT;
-          break;
-        }        
-      } while ((pszArg=strtok(NULL, ", ")) != nullptr);
-      if (!respCode) {
+        }
+      } else if (!strcasecmp_P(pszArg, PSTR("EVENTS"))) {
+        // optional sequence number of the last event already read
+        const char* pszSinceSeq = strtok(NULL, ",\r\n");
+        writer.printKey(F("events"));
+        ConstraintEventJournal::instance().print(writer, pszSinceSeq ? strtoul(pszSinceSeq,nullptr,10) : 0);
+        writer.noPrefixPrintln(",");
+      } else if (!strcasecmp_P(pszArg, PSTR("HISTORY"))) {
+        // optional sensor ID's (default is all sensors with history enabled)
+        historyIds.clear();
+        const char* pszId;
+        while ( (pszId=strtok(NULL, ",\r\n")) != NULL ) {
+          historyIds.push_back(atol(pszId));
+        }
+        beginSensorHistory();
+#ifdef AUTOMATION_PROFILING
+      } else if (!strcasecmp_P(pszArg, PSTR("STATS"))) {
+        printStats();
+#endif
+      } else if (!strcasecmp_P(pszArg, PSTR("SENSORS"))) {
+        beginListing(F("sensors"), sensors);
+      } else if (!strcasecmp_P(pszArg, PSTR("DEVICES"))) {
+        beginListing(F("devices"), devices);
+      } else if (!strcasecmp_P(pszArg, PSTR("CONSTRAINTS"))) {
+        beginListing(F("constraints"), Constraint::all());
+      } else if (!strcasecmp_P(pszArg, PSTR("CAPABILITIES"))) {
+        beginListing(F("capabilities"), Capability::all());
+      } else if (!strcasecmp_P(pszArg, PSTR("TIME"))) {
+        time_t t = now();
+        writer.printKey("time");
+        writer.noPrefixPrintln("{");
+        writer.increaseDepth();
+        writer.printlnNumberObj("year", year(t), ",");
+        writer.printlnNumberObj("month", month(t), ",");
+        writer.printlnNumberObj("day", day(t), ",");
+        writer.printlnNumberObj("hour", hour(t), ",");
+        writer.printlnNumberObj("minute", minute(t), ",");
+        writer.printlnNumberObj("second", second(t), ",");
+        writer.printlnBoolObj("timeSet", automation::isTimeValid());
+        writer.decreaseDepth();
+        writer.println("},");
+      } else {
         beginResp();
-        writer + "OK";
+        writer + F("get command expected {sensors|devices|events|history|stats|jsonFormat|time|env|setup|eeprom} but found: '") + pszArg + "'.";
+        respCode = INVALID_ARGUMENT;
+        lineState = LineState::End;
+        return;
       }
-      endResp(respCode);
+      pszArgs = strtok(NULL, "");
+      lineState = pszArgs ? LineState::GetArgs : LineState::End;
+    }
 
-      writer.decreaseDepth().print("}");
-      return respCode;
+    void beginSensorHistory() {
+      writer.printKey(F("history"));
+      writer.noPrefixPrintln("[");
+      writer.increaseDepth();
+      itemIndex = 0;
+      printedCnt = 0;
+      pPrintItem = &CommandProcessor::printSensorHistory;
     }
-    
+
+    // Next sensor with history enabled and in historyIds (all when empty)
+    bool printSensorHistory() {
+      for ( ; itemIndex < sensors.size(); itemIndex++ ) {
+        Sensor* pSensor = sensors[itemIndex];
+        if ( !pSensor->pHistory ) {
+          continue;
+        }
+        if ( !historyIds.empty() && std::find(historyIds.begin(),historyIds.end(),(unsigned long)pSensor->id) == historyIds.end() ) {
+          continue;
+        }
+        if ( printedCnt++ > 0 ) {
+          writer.noPrefixPrintln(",");
+        }
+        writer.println("{");
+        writer.increaseDepth();
+        writer.printlnStringObj(F("name"), pSensor->name, ",");
+        writer.printlnNumberObj(F("id"), (unsigned long) pSensor->id, ",");
+        writer.printKey(F("history"));
+        pSensor->pHistory->print(writer,bVerbose);
+        writer.noPrefixPrintln();
+        writer.decreaseDepth();
+        writer.print("}");
+        itemIndex++;
+        return true;
+      }
+      writer.noPrefixPrintln();
+      writer.decreaseDepth();
+      writer.println("],");
+      return false;
+    }
+
+#ifdef AUTOMATION_PROFILING
+    // only counters that have been called are printed
+    void printStats() {
+      writer.printKey(F("stats"));
+      writer.noPrefixPrintln("{");
+      writer.increaseDepth();
+      writer.printKey(F("commands"));
+      writer.noPrefixPrintln("[");
+      writer.increaseDepth();
+      bool bFirst = true;
+      for ( const CommandProfile& profile : commandProfiles() ) {
+        if ( !bFirst ) {
+          writer.noPrefixPrintln(",");
+        }
+        bFirst = false;
+        writer.println("{");
+        writer.increaseDepth();
+        writer.printlnStringObj(F("name"), profile.first, ",");
+        profile.second.print(writer);
+        writer.decreaseDepth();
+        writer.print("}");
+      }
+      writer.noPrefixPrintln();
+      writer.decreaseDepth();
+      writer.println("],");
+      printProfiles(F("devices"), devices, &Device::applyConstraintProfile, ",");
+      printProfiles(F("sensors"), sensors, &Sensor::getValueProfile, ",");
+      printProfiles(F("constraints"), Constraint::all(), &Constraint::testProfile, "");
+      writer.decreaseDepth();
+      writer.println("},");
+    }
+
+    template<typename TKey, typename Items, typename T>
+    void printProfiles(TKey key, const Items& items, automation::profile::Counter T::*pCounter, const char* suffix) {
+      writer.printKey(key);
+      writer.noPrefixPrintln("[");
+      writer.increaseDepth();
+      bool bFirst = true;
+      for ( T* pItem : items ) {
+        const automation::profile::Counter& counter = pItem->*pCounter;
+        if ( counter.callCnt == 0 ) {
+          continue;
+        }
+        if ( !bFirst ) {
+          writer.noPrefixPrintln(",");
+        }
+        bFirst = false;
+        writer.println("{");
+        writer.increaseDepth();
+        writer.printlnNumberObj(F("id"), (unsigned long) pItem->id, ",");
+        writer.printlnStringObj(F("title"), pItem->getTitle(), ",");
+        counter.print(writer);
+        writer.decreaseDepth();
+        writer.print("}");
+      }
+      writer.noPrefixPrintln();
+      writer.decreaseDepth();
+      writer.print("]");
+      writer.noPrefixPrintln(suffix);
+    }
+
+    void resetStats() {
+      for ( CommandProfile& profile : commandProfiles() ) {
+        profile.second.reset();
+      }
+      for ( Device* pDevice : devices ) {
+        pDevice->applyConstraintProfile.reset();
+      }
+      for ( Sensor* pSensor : sensors ) {
+        pSensor->getValueProfile.reset();
+      }
+      for ( Constraint* pConstraint : Constraint::all() ) {
+        pConstraint->testProfile.reset();
+      }
+    }
+#endif
 
     /////////
     // SET //
@@ -339,7 +661,7 @@ namespace arduino {
         if ( fmt != JsonFormat::INVALID ) {
           jsonFormat = fmt;
         } else {
-          writer + F("Expected COMPACT|PRETTY but found: ") + pszFormat;
+          writer + F("Expected COMPACT|PRETTY|BINARY|BINARY_FLOAT but found: ") + pszFormat;
           respCode = INVALID_ARGUMENT;
         }
       } else if (!strcasecmp_P(pszArg, PSTR("TIME"))) {
@@ -356,6 +678,7 @@ namespace arduino {
           int year = atoi(pszYear), month = atoi(pszMonth), day = atoi(pszDay),
               hour = atoi(pszHour), minute = atoi(pszMinute), second = atoi(pszSecond);
           setTime(hour, minute, second, day, month, year);
+          LocalTime::instance().clockChanged();
           writer + F("TIME set using YYYY,MM,DD,HH,mm,SS args: ");
           for( int i : {year,month,day,hour,minute,second} ) {
             writer + i + ",";
@@ -482,7 +805,7 @@ namespace arduino {
           if ( fmt != JsonFormat::INVALID ) {
             eeprom.setJsonFormat(fmt);
           } else {
-            writer + F("Expected COMPACT|PRETTY but found: ") + pszFormat;
+            writer + F("Expected COMPACT|PRETTY|BINARY|BINARY_FLOAT but found: ") + pszFormat;
             respCode = INVALID_ARGUMENT;
           }
         } else if ( !strcasecmp_P(pszField, PSTR("serialSpeed"))) {
@@ -5,6 +5,7 @@
 #include "../automation/json/JsonStreamWriter.h"
 
 #include <Adafruit_ADS1015.h>
+#include <Wire.h>
 
 using namespace automation::json;
 
@@ -31,11 +32,26 @@ public:
 
   const int16_t INVALID_RATED_MILLIVOLTS = 65532, INVALID_CHANNEL = 65533, FAIL_RETURN_VALUE = 0;
 
-  mutable Adafruit_ADS1115 ads {0x48};
+  // ADS1115 registers and config bits used for continuous conversion mode
+  static const uint8_t ADS1115_ADDRESS = 0x48,
+      REG_CONVERSION = 0x00,
+      REG_CONFIG = 0x01;
+  static const uint16_t CONFIG_MUX_DIFF_0_1 = 0x0000,
+      CONFIG_MUX_DIFF_2_3 = 0x3000,
+      CONFIG_MUX_SINGLE_0 = 0x4000,
+      CONFIG_MODE_CONTINUOUS = 0x0000,
+      CONFIG_COMP_QUE_DISABLE = 0x0003;
+
+  // Running average is halved when it gets this many conversions so the sum cannot overflow
+  static const uint16_t MAX_AVERAGE_CNT = 16384;
+
+  mutable Adafruit_ADS1115 ads {ADS1115_ADDRESS};
   RatedAmps ratedAmps;
   MilliVoltDrop ratedMillivolts;
   Channel channel;
   adsGain_t gain;
+  bool bContinuous = true; // ADS1115 converts continuously and readings come from the conversion register
+  uint16_t dataRate = 128; // samples per second (ADS1115: 8,16,32,64,128,250,475,860)
 
   CurrentSensor(const char *name,
                 RatedAmps ratedAmps = RATED_200_AMPS,
@@ -51,9 +67,32 @@ public:
   void setup() override {
     ads.setGain(gain);    
     ads.begin();
+    bConfigured = false;
     setInitialized(true);
   }
 
+  // Fold every finished conversion into the running average (continuous mode only)
+  void poll() override {
+    if ( !bContinuous || !isInitialized() || channel > DIFFERENTIAL_2_3 ) {
+      return;
+    }
+    if ( !bConfigured ) {
+      startContinuous();
+      return;
+    }
+    unsigned long nowUs = micros();
+    if ( nowUs - lastConversionUs < getConversionPeriodUs() ) {
+      return;
+    }
+    lastConversionUs = nowUs;
+    lastADC = readConversion();
+    adcSum += lastADC;
+    if ( ++adcCnt >= MAX_AVERAGE_CNT ) {
+      adcSum /= 2;
+      adcCnt /= 2;
+    }
+  }
+
   float getValueImpl() const override {
     float amps = readAmps();
     return amps;
@@ -62,9 +101,13 @@ public:
   virtual float readAmps() const {
     float rtnAmps = 0;
 
-    int16_t shuntADC = -1;
-    for ( int i = 0; i < 3 && shuntADC < 0; i++ ) {
-      shuntADC = readADC(i==0?0:75);
+    float shuntADC = -1;
+    if ( bContinuous && bConfigured ) {
+      shuntADC = readAverageADC();
+    } else {
+      for ( int i = 0; i < 3 && shuntADC < 0; i++ ) {
+        shuntADC = readADC(i==0?0:75);
+      }
     }
     /*if (shuntADC < 0) {
       status.error( __PRETTY_FUNCTION__ );
@@ -79,13 +122,42 @@ public:
       status.msg += channel;
       rtnAmps = FAIL_RETURN_VALUE;
     } else {
-      double milliVolts = shuntADC * getMilliVoltIncrement();
-      rtnAmps = milliVolts / getRatedMilliOhms();
+      rtnAmps = adcToAmps(shuntADC);
     }
     return rtnAmps;
   }
 
+  double adcToAmps(double shuntADC) const {
+    double milliVolts = shuntADC * getMilliVoltIncrement();
+    return milliVolts / getRatedMilliOhms();
+  }
+
+  // Latest conversion without disturbing the running average (energy integration).  NaN if channel invalid.
+  float readLatestAmps() const {
+    if ( channel > DIFFERENTIAL_2_3 ) {
+      return NAN;
+    }
+    if ( bContinuous && bConfigured ) {
+      return adcCnt ? adcToAmps(lastADC) : adcToAmps(readConversion());
+    }
+    return adcToAmps(readADC());
+  }
+
+  // Average of conversions since last call.  Falls back to latest conversion if poll() has not run.
+  float readAverageADC() const {
+    if ( adcCnt == 0 ) {
+      return readConversion();
+    }
+    float rtn = (float) adcSum / adcCnt;
+    adcSum = 0;
+    adcCnt = 0;
+    return rtn;
+  }
+
   virtual int16_t readADC(int delayMs = 0) const {
+    if ( bContinuous && bConfigured ) {
+      return readConversion(); // no delay needed... register always has the last conversion
+    }
     delay(delayMs);
 
     int16_t adc;
@@ -102,6 +174,64 @@ public:
     return adc;
   }
 
+  // Program the ADS1115 once for continuous conversion and leave the register pointer on the conversion result
+  void startContinuous() const {
+    uint16_t config = CONFIG_MODE_CONTINUOUS | CONFIG_COMP_QUE_DISABLE | gain | getDataRateBits();
+    if ( channel <= CHANNEL_A3 ) {
+      config |= CONFIG_MUX_SINGLE_0 + (channel << 12);
+    } else if ( channel == DIFFERENTIAL_0_1 ) {
+      config |= CONFIG_MUX_DIFF_0_1;
+    } else {
+      config |= CONFIG_MUX_DIFF_2_3;
+    }
+    Wire.beginTransmission(ADS1115_ADDRESS);
+    Wire.write(REG_CONFIG);
+    Wire.write((uint8_t)(config>>8));
+    Wire.write((uint8_t)(config & 0xFF));
+    Wire.endTransmission();
+    Wire.beginTransmission(ADS1115_ADDRESS);
+    Wire.write(REG_CONVERSION);
+    Wire.endTransmission();
+    adcSum = 0;
+    adcCnt = 0;
+    lastConversionUs = micros();
+    bConfigured = true;
+  }
+
+  int16_t readConversion() const {
+    Wire.requestFrom(ADS1115_ADDRESS, (uint8_t)2);
+    uint8_t high = Wire.read();
+    uint8_t low = Wire.read();
+    return (int16_t)((high << 8) | low);
+  }
+
+  static bool isValidDataRate(long rate) {
+    switch (rate) {
+      case 8: case 16: case 32: case 64: case 128: case 250: case 475: case 860:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  uint16_t getDataRateBits() const {
+    switch (dataRate) {
+      case 8: return 0x0000;
+      case 16: return 0x0020;
+      case 32: return 0x0040;
+      case 64: return 0x0060;
+      case 250: return 0x00A0;
+      case 475: return 0x00C0;
+      case 860: return 0x00E0;
+      case 128: 
+      default: return 0x0080;
+    }
+  }
+
+  unsigned long getConversionPeriodUs() const {
+    return 1000000UL / (dataRate ? dataRate : 128);
+  }
+
   double getRatedMilliOhms() const {
     double mv = ratedMillivolts;
     double amps = ratedAmps;
@@ -142,6 +272,9 @@ public:
     w.printlnStringObj(F("channel"), strChannel,",");
     int16_t shuntADC = readADC(50);
     w.printlnNumberObj(F("shuntADC"), shuntADC, ",");
+    w.printlnBoolObj(F("continuous"), bContinuous, ",");
+    w.printlnNumberObj(F("dataRate"), dataRate, ",");
+    w.printlnNumberObj(F("averageCnt"), adcCnt, ",");
     String strGain;
     switch (gain) {
       case GAIN_ONE: strGain = F("GAIN_ONE"); break;
@@ -173,7 +306,21 @@ public:
     }
     SetCode rtn = ArduinoSensor::setAttribute(pszKey,pszVal,pRespStream);
     if ( rtn == SetCode::Ignored ) {
-      if ( !strcasecmp_P(pszKey, PSTR("ratedAmps")) ) {
+      if ( !strcasecmp_P(pszKey, PSTR("continuous")) ) {
+        bContinuous = text::parseBool(pszVal);
+        rtn = SetCode::OK;
+      } else if ( !strcasecmp_P(pszKey, PSTR("dataRate")) ) {
+        long rate = atol(pszVal);
+        if ( isValidDataRate(rate) ) {
+          dataRate = rate;
+          rtn = SetCode::OK;
+        } else {
+          rtn = SetCode::Error;
+          if (pRespStream) {
+            (*pRespStream) << F("Invalid value: ") << pszVal << F(" (8,16,32,64,128,250,475,860)");
+          }
+        }
+      } else if ( !strcasecmp_P(pszKey, PSTR("ratedAmps")) ) {
         ratedAmps = atol(pszVal);
         rtn = SetCode::OK;
       } else if ( !strcasecmp_P(pszKey, PSTR("ratedMillivolts")) ) {
@@ -220,6 +367,9 @@ public:
           }
         }
       }
+      if ( rtn == SetCode::OK ) {
+        bConfigured = false; // reprogram continuous mode with new settings on next poll()
+      }
       if (pRespStream && rtn == SetCode::OK ) {
         (*pRespStream) << "'" << name << "' " << pszKey << "=" << pszVal;
       }
@@ -227,6 +377,13 @@ public:
     return rtn;
   }
 
+protected:
+  mutable bool bConfigured = false;
+  mutable long adcSum = 0;
+  mutable uint16_t adcCnt = 0;
+  mutable int16_t lastADC = 0;
+  mutable unsigned long lastConversionUs = 0;
+
 };
 
 #endif
@@ -3,19 +3,25 @@
 
 #include "Arduino.h"
 #include "Status.h"
+#include "../automation/sensor/Sensor.h"
 
 #include <DHT.h>
 
 #define FAHRENHEIT true
 
 
+// Temperature and humidity come from the same bus transaction so one read per sampling epoch is cached
+// and shared by DhtTempSensor and DhtHumiditySensor.  Failed reads are retried in a later epoch instead
+// of sleeping and the last good reading is used until RETRY_COUNT reads in a row have failed.
 class Dht : public DHT {
   public:
   int sensorPin;
   bool bInitialized;
   Status status;
   
-  const int16_t RETRY_COUNT = 4, RETRY_WAIT_MS = 200, FAIL_VALUE = 0;
+  // DHT22 needs 2 seconds between reads (faster reads just fail) so retries wait just as long
+  const int16_t RETRY_COUNT = 4, FAIL_VALUE = 0;
+  const uint16_t MIN_READ_INTERVAL_MS = 2000;
 
   Dht(int sensorPin, int dhtType = DHT22) 
   : DHT(sensorPin,dhtType),
@@ -30,38 +36,62 @@ class Dht : public DHT {
     }
   }
 
-  virtual float readTemp() 
-  {      
-    status.reset();
-    float rtn = readTemperature(FAHRENHEIT);
-    for (int i = 0; i < RETRY_COUNT && isnan(rtn); i++ ){
-      automation::sleep(RETRY_WAIT_MS);
-      rtn = readTemperature(FAHRENHEIT);      
+  // Returns true if cached values are usable.  At most one bus transaction per sampling epoch and
+  // per MIN_READ_INTERVAL_MS.
+  bool update()
+  {
+    unsigned long nowMs = automation::millisecs();
+    automation::Sensor::Generation generation = automation::Sensor::currentGeneration();
+    if ( bReadAttempted && (readGeneration == generation || (nowMs - readTimeMs) < MIN_READ_INTERVAL_MS) ) {
+      return isValid();
     }
-    if ( isnan(rtn) ) {
-      String errMsg = F("Dht::readTemp() returned NaN");
-      status.error(errMsg) ;
-      rtn = FAIL_VALUE;
+    bReadAttempted = true;
+    readTimeMs = nowMs;
+    readGeneration = generation;
+    float temp = readTemperature(FAHRENHEIT,/*force=*/true);
+    float humidity = DHT::readHumidity(); // uses data from the forced read above
+    if ( isnan(temp) || isnan(humidity) ) {
+      if ( failCnt < 255 ) {
+        failCnt++;
+      }
+      if ( !isValid() ) {
+        String errMsg = F("Dht::update() returned NaN. Failed reads: ");
+        errMsg += failCnt;
+        status.error(errMsg);
+      }
+    } else {
+      failCnt = 0;
+      cachedTemp = temp;
+      cachedHumidity = humidity;
+      goodReadTimeMs = nowMs;
+      bHaveReading = true;
+      status.reset();
     }
-    return rtn;
+    return isValid();
+  }
+
+  bool isValid() const { return bHaveReading && failCnt <= RETRY_COUNT; }
+
+  unsigned long getReadingAgeMs() const { return automation::millisecs() - goodReadTimeMs; }
+
+  uint8_t getFailCount() const { return failCnt; }
+
+  virtual float readTemp() 
+  {      
+    return update() ? cachedTemp : FAIL_VALUE;
   }
 
   virtual float readHumidity()
   {
-    status.reset();
-    float rtn = DHT::readHumidity();
-    for (int i = 0; i < RETRY_COUNT && isnan(rtn); i++ ){
-      automation::sleep(RETRY_WAIT_MS);
-      rtn = DHT::readHumidity();
-    }
-    if ( isnan(rtn) ) {
-      String errMsg = F("Dht::readHumidity() returned NaN");
-      status.error(errMsg);
-      rtn = FAIL_VALUE;
-    }
-    return rtn;
+    return update() ? cachedHumidity : FAIL_VALUE;
   }
 
+  protected:
+  float cachedTemp = 0, cachedHumidity = 0;
+  unsigned long readTimeMs = 0, goodReadTimeMs = 0;
+  automation::Sensor::Generation readGeneration = 0;
+  uint8_t failCnt = 0;
+  bool bReadAttempted = false, bHaveReading = false;
 
 };
-#endif
\ No newline at end of file
+#endif
@@ -22,6 +22,11 @@ class DhtSensor : public ArduinoSensor {
       setInitialized(true);
     }
   }
+
+  void printVerboseExtra(JsonStreamWriter& w) const override {
+    w.printlnNumberObj(F("readingAgeMs"),dht.getReadingAgeMs(),",");
+    w.printlnNumberObj(F("failCnt"),(int)dht.getFailCount(),",");
+  }
   
 };
 
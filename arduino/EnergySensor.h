@@ -0,0 +1,101 @@
+#ifndef ARDUINO_ENERGY_SENSOR_H
+#define ARDUINO_ENERGY_SENSOR_H
+
+#include "VoltageSensor.h"
+#include "CurrentSensor.h"
+#include "../automation/sensor/TrapezoidIntegrator.h"
+
+#include <vector>
+
+namespace arduino {
+
+  // Integrates bank current and power between sampling epochs.  Current is the latest shunt conversion
+  // and voltage is the last published value since battery voltage changes slowly compared to current.
+  class EnergyMeter {
+  public:
+    static const uint16_t DEFAULT_INTERVAL_MS = 250;
+
+    static std::vector<EnergyMeter*>& all() {
+      static std::vector<EnergyMeter*> meters;
+      return meters;
+    }
+
+    VoltageSensor *pVoltageSensor;
+    CurrentSensor *pCurrentSensor;
+    uint16_t intervalMs;
+    automation::TrapezoidIntegrator ampHours, wattHours;
+    std::vector<Sensor*> sensors; // EnergySensors reporting the totals
+
+    EnergyMeter(VoltageSensor *pVoltageSensor, CurrentSensor *pCurrentSensor, uint16_t intervalMs = DEFAULT_INTERVAL_MS) :
+        pVoltageSensor(pVoltageSensor),
+        pCurrentSensor(pCurrentSensor),
+        intervalMs(intervalMs) {
+      all().push_back(this);
+    }
+
+    void poll() {
+      TimerVal nowMs = millisecs64();
+      if ( lastMs && nowMs - lastMs < intervalMs ) {
+        return;
+      }
+      lastMs = nowMs;
+      float amps = pCurrentSensor->readLatestAmps();
+      if ( isnan(amps) ) {
+        return;
+      }
+      ampHours.add(amps, nowMs);
+      wattHours.add(amps * pVoltageSensor->getValue(), nowMs);
+    }
+
+    // Only the totals' sensors drop their cached values so they read back zero right away
+    void reset() {
+      ampHours.reset();
+      wattHours.reset();
+      for ( Sensor* pSensor : sensors ) {
+        pSensor->reset();
+      }
+    }
+
+  protected:
+    TimerVal lastMs = 0;
+  };
+
+  // One of the energy meter totals.  Charge is positive bank current.
+  class EnergySensor : public Sensor {
+  public:
+    RTTI_GET_TYPE_IMPL(arduino,EnergySensor)
+
+    enum Total : uint8_t { CHARGE_AMP_HOURS, DISCHARGE_AMP_HOURS, CHARGE_WATT_HOURS, DISCHARGE_WATT_HOURS };
+
+    EnergyMeter& meter;
+    Total total;
+
+    EnergySensor(const char *const name, EnergyMeter& meter, Total total) :
+        Sensor(name),
+        meter(meter),
+        total(total) {
+      setCanSample(false);
+      meter.sensors.push_back(this);
+    }
+
+    void poll() override {
+      meter.poll(); // meter ignores calls until its interval elapses so sharing it is cheap
+    }
+
+    float getValueImpl() const override {
+      switch (total) {
+        case CHARGE_AMP_HOURS: return meter.ampHours.getPositiveHours();
+        case DISCHARGE_AMP_HOURS: return meter.ampHours.getNegativeHours();
+        case CHARGE_WATT_HOURS: return meter.wattHours.getPositiveHours();
+        case DISCHARGE_WATT_HOURS: 
+        default: return meter.wattHours.getNegativeHours();
+      }
+    }
+
+    void printVerboseExtra(JsonStreamWriter& w) const override {
+      w.printlnNumberObj(F("intervalMs"), meter.intervalMs, ",");
+    }
+  };
+
+}
+#endif
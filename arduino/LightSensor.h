@@ -21,7 +21,7 @@ class LightSensor : public AnalogSensor {
   RTTI_GET_TYPE_IMPL(arduino,LightSensor)
   
   float getValueImpl() const override {
-    int percent = 100.0 * analogRead(sensorPin)/1023.0;
+    int percent = 100.0 * readAnalog()/1023.0;
     //float rThermistor = balanceResistance * ( (1023.0 / pinVoltage) - 1);
     //return rThermistor;
     // Vout/Vin = R2/(R1+R2)
@@ -4,6 +4,7 @@
 #include "ArduinoSensor.h"
 #include "VoltageSensor.h"
 #include "CurrentSensor.h"
+#include "EnergySensor.h"
 
 namespace arduino {
 
@@ -17,14 +18,20 @@ namespace arduino {
   
     VoltageSensor *pVoltageSensor;
     CurrentSensor *pCurrentSensor;
+    EnergyMeter energyMeter; // amp and watt hours integrated between epochs (see EnergySensor)
 
     PowerSensor(const char *const name, VoltageSensor *pVoltageSensor, CurrentSensor *pCurrentSensor) :
         Sensor(name),
         pVoltageSensor(pVoltageSensor),
-        pCurrentSensor(pCurrentSensor) {
+        pCurrentSensor(pCurrentSensor),
+        energyMeter(pVoltageSensor,pCurrentSensor) {
           setCanSample(false); 
     }
 
+    void poll() override {
+      energyMeter.poll();
+    }
+
     float getValueImpl() const override {
       float watts = pVoltageSensor->getValue() * pCurrentSensor->getValue();
       return watts;
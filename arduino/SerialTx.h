@@ -0,0 +1,134 @@
+#ifndef ARDUINO_SERIAL_TX_H
+#define ARDUINO_SERIAL_TX_H
+
+#include "../automation/json/OutputStreamPrinter.h"
+
+#include <iostream>
+
+namespace arduino {
+
+  // Transmit ring in front of HardwareSerial.  Bytes are handed to Serial only while its 64 byte buffer
+  // has room so writes never block inside Serial.write() and the USART interrupt drains the rest.  loop()
+  // writes the next chunk of a response when the ring is half empty (isHalfEmpty()) so the ring keeps
+  // Serial busy between passes.  A chunk longer than the free space waits here and the idle handler runs.
+  // It is called in the middle of a chunk so it must not change state the chunk is reporting (watchdog
+  // and sensor polling only).
+  class SerialTx : public std::streambuf {
+  public:
+    static const uint16_t CAPACITY = 256;
+
+    typedef void (*IdleHandler)();
+
+    SerialTx(HardwareSerial& serial) : serial(serial) {
+    }
+
+    void setIdleHandler(IdleHandler handler) { idleHandler = handler; }
+
+    uint16_t getPendingCnt() const { return count; }
+
+    bool isHalfEmpty() const { return count <= CAPACITY / 2; }
+
+    // Move as many bytes to Serial as it accepts without blocking
+    void pump() {
+      while ( count > 0 ) {
+        int room = serial.availableForWrite();
+        if ( room <= 0 ) {
+          return;
+        }
+        uint16_t n = CAPACITY - tail;
+        if ( n > count ) {
+          n = count;
+        }
+        if ( n > (uint16_t) room ) {
+          n = room;
+        }
+        serial.write(ring+tail, n);
+        tail = (tail + n) % CAPACITY;
+        count -= n;
+      }
+    }
+
+    // Blocking, used before a reset so the response is not lost
+    void drain() {
+      while ( count > 0 ) {
+        serial.write(ring[tail]);
+        tail = (tail + 1) % CAPACITY;
+        count--;
+      }
+      serial.flush();
+    }
+
+  protected:
+    HardwareSerial& serial;
+    IdleHandler idleHandler = nullptr;
+    bool bInIdle = false;
+    uint8_t ring[CAPACITY];
+    uint16_t head = 0, tail = 0, count = 0;
+
+    void waitForSpace() {
+      pump();
+      while ( count == CAPACITY ) {
+        if ( idleHandler && !bInIdle ) {
+          bInIdle = true;
+          idleHandler();
+          bInIdle = false;
+        }
+        pump();
+      }
+    }
+
+    int overflow(int c) override {
+      if ( c == EOF ) {
+        return 0;
+      }
+      if ( count == CAPACITY ) {
+        waitForSpace();
+      }
+      ring[head] = (uint8_t) c;
+      head = (head + 1) % CAPACITY;
+      count++;
+      return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+      std::streamsize remaining = n;
+      while ( remaining > 0 ) {
+        if ( count == CAPACITY ) {
+          waitForSpace();
+        }
+        uint16_t chunk = CAPACITY - head; // contiguous up to the end of the ring
+        uint16_t room = CAPACITY - count;
+        if ( chunk > room ) {
+          chunk = room;
+        }
+        if ( chunk > remaining ) {
+          chunk = remaining;
+        }
+        memcpy(ring+head, s, chunk);
+        head = (head + chunk) % CAPACITY;
+        count += chunk;
+        s += chunk;
+        remaining -= chunk;
+      }
+      pump();
+      return n;
+    }
+
+    int sync() override {
+      pump();
+      return 0;
+    }
+  };
+
+  SerialTx serialTx(Serial);
+
+  struct SerialTxStreamPrinter : public automation::json::OutputStreamPrinter {
+    std::ostream os;
+    SerialTxStreamPrinter(SerialTx& tx) : OutputStreamPrinter(&os), os(&tx) {}
+  };
+
+  SerialTxStreamPrinter serialTxPrinter(serialTx);
+
+}
+
+#endif
@@ -27,8 +27,10 @@ struct Status {
   bool ok() { return code == 0; }
 
   void reset() {
-    msg = "";
-    code = 0;
+    if ( code != 0 || msg.length() ) {
+      msg = "";
+      code = 0;
+    }
   }
 
   void noPrefixPrint(JsonStreamWriter& w, bool bVerbose=false) { 
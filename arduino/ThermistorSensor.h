@@ -6,17 +6,40 @@
 
 namespace arduino {
 
+// ADC code to fahrenheit lookup with linear interpolation between every 8th code.  Values are
+// fahrenheit * 32.  Default table matches ThermistorSensor default constructor parameters.
+namespace thermistor {
+  const uint8_t TABLE_SHIFT = 3, TABLE_SIZE = (1024 >> TABLE_SHIFT) + 1;
+  const int16_t FIXED_POINT_SCALE = 32;
+
+  const int16_t defaultTable[TABLE_SIZE] PROGMEM = {
+    -3808, -2133, -1626, -1308, -1070, -878, -716, -575, -450, -336, -232, -136, -46, 39, 118, 194,
+    266, 335, 401, 465, 526, 586, 643, 699, 754, 807, 859, 910, 960, 1009, 1057, 1104,
+    1151, 1196, 1241, 1286, 1330, 1373, 1416, 1459, 1501, 1543, 1584, 1626, 1667, 1707, 1748, 1788,
+    1828, 1868, 1908, 1948, 1988, 2028, 2067, 2107, 2147, 2186, 2226, 2266, 2306, 2346, 2386, 2426,
+    2467, 2507, 2548, 2589, 2631, 2672, 2714, 2757, 2799, 2842, 2886, 2930, 2974, 3019, 3064, 3110,
+    3157, 3204, 3252, 3300, 3349, 3400, 3451, 3503, 3555, 3609, 3665, 3721, 3778, 3837, 3898, 3959,
+    4023, 4088, 4156, 4225, 4297, 4371, 4448, 4527, 4610, 4696, 4786, 4881, 4980, 5084, 5194, 5311,
+    5435, 5568, 5710, 5865, 6032, 6217, 6421, 6649, 6909, 7209, 7564, 7997, 8548, 9301, 10457, 12800,
+    25738
+  };
+}
+
 class ThermistorSensor : public AnalogSensor {
   public:
+  static constexpr float DEFAULT_BETA = 3950, DEFAULT_BALANCE_RESISTANCE = 9999.0,
+      DEFAULT_ROOM_TEMP_RESISTANCE = 10000.0, DEFAULT_ROOM_TEMP_KELVIN = 298.15;
+
   float beta; //3950.0,  3435.0 
   float balanceResistance, roomTempResistance, roomTempKelvin;
+  bool bLookupTable = true; // use interpolated table instead of beta formula for each sample
     
   ThermistorSensor(const char* const name,
              int sensorPin, 
-             float beta = 3950, 
-             float balanceResistance = 9999.0, 
-             float roomTempResistance = 10000.0,
-             float roomTempKelvin = 298.15):
+             float beta = DEFAULT_BETA, 
+             float balanceResistance = DEFAULT_BALANCE_RESISTANCE, 
+             float roomTempResistance = DEFAULT_ROOM_TEMP_RESISTANCE,
+             float roomTempKelvin = DEFAULT_ROOM_TEMP_KELVIN):
     AnalogSensor(name,sensorPin,20,25),
     beta(beta),
     balanceResistance(balanceResistance),
@@ -28,13 +51,24 @@ class ThermistorSensor : public AnalogSensor {
   RTTI_GET_TYPE_IMPL(arduino,ThermistorSensor)
  
   
+  virtual ~ThermistorSensor() {
+    delete[] pTable;
+  }
+
   float getValueImpl() const override {
+    if ( bLookupTable ) {
+      return this->readTableTemp();
+    }
     return this->readBetaCalculatedTemp();
   }
 
   virtual float readBetaCalculatedTemp() const
   {
-    int pinVoltage = analogRead(sensorPin);
+    return betaCalculatedTemp(readAnalog());
+  }
+
+  float betaCalculatedTemp(float pinVoltage) const
+  {
     float rThermistor = balanceResistance * ( (1023.0 / pinVoltage) - 1);
     float tKelvin = (beta * roomTempKelvin) / 
             (beta + (roomTempKelvin * log(rThermistor / roomTempResistance)));
@@ -44,6 +78,25 @@ class ThermistorSensor : public AnalogSensor {
     return tFahrenheit;
   }
 
+  // Interpolated table lookup (no floating point log or division per sample)
+  float readTableTemp() const
+  {
+    float pinVoltage = readAnalog();
+    if ( pinVoltage < 0 ) {
+      pinVoltage = 0;
+    } else if ( pinVoltage > 1023 ) {
+      pinVoltage = 1023;
+    }
+    // 1/16 ADC code resolution so fractional scanner averages are not truncated
+    const uint8_t fracBits = thermistor::TABLE_SHIFT + 4;
+    uint16_t code16 = pinVoltage * 16 + 0.5;
+    uint8_t index = code16 >> fracBits;
+    int32_t frac = code16 & ((1 << fracBits) - 1);
+    int32_t lower = tableAt(index), upper = tableAt(index+1);
+    int32_t fixedTemp = lower + (((upper - lower) * frac + (1 << (fracBits - 1))) >> fracBits); // rounded
+    return (float) fixedTemp / thermistor::FIXED_POINT_SCALE;
+  }
+
   virtual SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream = nullptr) override {
     SetCode rtn = AnalogSensor::setAttribute(pszKey,pszVal,pRespStream);
     if ( rtn == SetCode::Ignored ) {
@@ -56,6 +109,15 @@ class ThermistorSensor : public AnalogSensor {
       } else if ( !strcasecmp_P(pszKey, PSTR("roomTempResistance")) ) {
         roomTempResistance = atof(pszVal);
         rtn = SetCode::OK;
+      } else if ( !strcasecmp_P(pszKey, PSTR("roomTempKelvin")) ) {
+        roomTempKelvin = atof(pszVal);
+        rtn = SetCode::OK;
+      } else if ( !strcasecmp_P(pszKey, PSTR("lookupTable")) ) {
+        bLookupTable = text::parseBool(pszVal);
+        rtn = SetCode::OK;
+      }
+      if ( rtn == SetCode::OK ) {
+        bTableValid = false; // rebuilt on next read
       }
       if (pRespStream && rtn == SetCode::OK ) {
         (*pRespStream) << "'" << name << "' " << pszKey << "=" << pszVal;
@@ -65,9 +127,44 @@ class ThermistorSensor : public AnalogSensor {
   }
 
   virtual void printVerboseExtra(JsonStreamWriter& w) const override {
+    AnalogSensor::printVerboseExtra(w);
     w.printlnNumberObj(F("beta"),beta,",");
     w.printlnNumberObj(F("balanceResistance"),balanceResistance,",");
     w.printlnNumberObj(F("roomTempResistance"),roomTempResistance,",");
+    w.printlnNumberObj(F("roomTempKelvin"),roomTempKelvin,",");
+    w.printlnBoolObj(F("lookupTable"),bLookupTable,",");
+  }
+
+  protected:
+  mutable int16_t* pTable = nullptr; // only allocated when parameters differ from defaults
+  mutable bool bTableValid = false, bDefaultTable = true;
+
+  bool isDefaultParameters() const {
+    return beta == DEFAULT_BETA && balanceResistance == DEFAULT_BALANCE_RESISTANCE 
+        && roomTempResistance == DEFAULT_ROOM_TEMP_RESISTANCE && roomTempKelvin == DEFAULT_ROOM_TEMP_KELVIN;
+  }
+
+  int16_t tableAt(uint8_t index) const {
+    if ( !bTableValid ) {
+      buildTable();
+    }
+    return bDefaultTable ? (int16_t) pgm_read_word(&thermistor::defaultTable[index]) : pTable[index];
+  }
+
+  void buildTable() const {
+    bDefaultTable = isDefaultParameters();
+    if ( !bDefaultTable ) {
+      if ( !pTable ) {
+        pTable = new int16_t[thermistor::TABLE_SIZE];
+      }
+      for ( uint8_t i = 0; i < thermistor::TABLE_SIZE; i++ ) {
+        float code = i << thermistor::TABLE_SHIFT;
+        code = code < 0.5 ? 0.5 : code > 1022.5 ? 1022.5 : code; // ends of the curve are infinite
+        float fixedTemp = betaCalculatedTemp(code) * thermistor::FIXED_POINT_SCALE;
+        pTable[i] = fixedTemp > 32767 ? 32767 : fixedTemp < -32768 ? -32768 : (int16_t) lround(fixedTemp);
+      }
+    }
+    bTableValid = true;
   }
 
 };
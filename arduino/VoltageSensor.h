@@ -42,13 +42,14 @@ public:
 
   float readVoltage() const {
     updateVcc(maxVccAgeMs);
-    float vr2 = VoltageSensor::vcc * analogRead(sensorPin) / 1023.0;
+    float vr2 = VoltageSensor::vcc * readAnalog() / 1023.0;
     float dividerWeight = ((float) (r1 + r2)) / r2;
     float vin = dividerWeight * vr2;
     return vin;
   }
 
   void printVerboseExtra(JsonStreamWriter& w) const override {
+    AnalogSensor::printVerboseExtra(w);
     w.printlnNumberObj(F("vcc"), vcc, ",");
     w.printlnNumberObj(F("r1"), r1, ",");
     w.printlnNumberObj(F("r2"), r2, ",");
@@ -48,6 +48,7 @@ namespace automation {
   static bool bSynchronizing = false;
 
   unsigned long millisecs();
+  unsigned long microsecs(); // wraps, only for measuring short durations
 
   // TODO: review calls to 32 bit millisecs() and consider 64 bit version if rollover impacts computations
   #ifdef ARDUINO_APP
@@ -124,6 +125,19 @@ namespace automation {
 
   void sleep(unsigned long intervalMs);
 
+  // Guard data shared with interrupt handlers.  Restores the previous interrupt state on exit.
+  #ifdef ARDUINO_APP
+  struct InterruptLock {
+    uint8_t sreg;
+    InterruptLock() : sreg(SREG) { cli(); }
+    ~InterruptLock() { SREG = sreg; }
+  };
+  #else
+  struct InterruptLock {
+    InterruptLock() {}
+  };
+  #endif
+
   bool isTimeValid(); // handle arduino with time never set
 
   void threadKeepAliveReset();
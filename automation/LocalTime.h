@@ -0,0 +1,74 @@
+#ifndef AUTOMATION_LOCAL_TIME_H
+#define AUTOMATION_LOCAL_TIME_H
+
+#include "Automation.h"
+
+#include <ctime>
+#include <stdint.h>
+
+namespace automation {
+
+  // Local time shared by the time based constraints.  localtime() is only called when the cached value
+  // is a second or more old so many constraints tested in one pass cost one conversion.
+  class LocalTime {
+  public:
+    static const uint32_t SECONDS_PER_DAY = 86400UL;
+
+    static LocalTime& instance() {
+      static LocalTime instance;
+      return instance;
+    }
+
+    static uint32_t toSecondsOfDay(int hour, int minute, int second) {
+      return hour*3600UL + minute*60UL + second;
+    }
+
+    uint32_t getSecondsOfDay() {
+      refresh();
+      return secondsOfDay;
+    }
+
+    const struct tm& getTm() {
+      refresh();
+      return tmNow;
+    }
+
+    time_t getTime() {
+      refresh();
+      return timeNow;
+    }
+
+    // Next call reads the clock again
+    void invalidate() { bValid = false; }
+
+    // Clock was set... anything computed from an earlier time is wrong
+    void clockChanged() { 
+      invalidate();
+      clockGeneration++;
+    }
+
+    uint8_t getClockGeneration() const { return clockGeneration; }
+
+  protected:
+    bool bValid = false;
+    uint8_t clockGeneration = 0;
+    unsigned long refreshTimeMs = 0;
+    time_t timeNow = 0;
+    struct tm tmNow;
+    uint32_t secondsOfDay = 0;
+
+    void refresh() {
+      unsigned long nowMs = millisecs();
+      if ( bValid && nowMs - refreshTimeMs < SECONDS ) {
+        return;
+      }
+      bValid = true;
+      refreshTimeMs = nowMs;
+      timeNow = std::time(nullptr);
+      tmNow = *localtime(&timeNow);
+      secondsOfDay = toSecondsOfDay(tmNow.tm_hour, tmNow.tm_min, tmNow.tm_sec);
+    }
+  };
+
+}
+#endif
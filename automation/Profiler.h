@@ -0,0 +1,69 @@
+#ifndef AUTOMATION_PROFILER_H
+#define AUTOMATION_PROFILER_H
+
+#include "Automation.h"
+#include "json/JsonStreamWriter.h"
+
+#include <stdint.h>
+
+// Call counts and durations for the hot paths (Constraint::test(), Sensor::getValue(), Device::applyConstraint() 
+// and CommandProcessor::executeLine()).  Define AUTOMATION_PROFILING before including automation headers to 
+// enable.  Otherwise the counters and timing code are not compiled.
+// PROFILE_START/PROFILE_STOP time code that begins and ends in different functions.
+#ifdef AUTOMATION_PROFILING
+  #define PROFILE_COUNTER(name) mutable automation::profile::Counter name;
+  #define PROFILE_SCOPE(counter) automation::profile::Scope profileScope(counter);
+  #define PROFILE_START_US(name) unsigned long name = 0;
+  #define PROFILE_START(startUs) startUs = automation::microsecs();
+  #define PROFILE_STOP(counter,startUs) counter.add(automation::microsecs() - startUs);
+#else
+  #define PROFILE_COUNTER(name)
+  #define PROFILE_SCOPE(counter)
+  #define PROFILE_START_US(name)
+  #define PROFILE_START(startUs)
+  #define PROFILE_STOP(counter,startUs)
+#endif
+
+namespace automation {
+  namespace profile {
+
+#ifdef AUTOMATION_PROFILING
+    struct Counter {
+      uint32_t callCnt = 0;
+      uint32_t totalUs = 0; // wraps after about 71 minutes of time spent in the counted code
+      uint32_t maxUs = 0;
+
+      void add(unsigned long elapsedUs) {
+        callCnt++;
+        totalUs += elapsedUs;
+        if ( elapsedUs > maxUs ) {
+          maxUs = elapsedUs;
+        }
+      }
+
+      void reset() {
+        callCnt = totalUs = maxUs = 0;
+      }
+
+      // Prints fields only so the caller can add its own (id, name)
+      void print(json::JsonStreamWriter& w) const {
+        w.printlnNumberObj(F("calls"), (unsigned long) callCnt, ",");
+        w.printlnNumberObj(F("totalUs"), (unsigned long) totalUs, ",");
+        w.printlnNumberObj(F("maxUs"), (unsigned long) maxUs);
+      }
+    };
+
+    // Adds time until the end of the enclosing block to a counter
+    struct Scope {
+      Counter& counter;
+      unsigned long startUs;
+
+      Scope(Counter& counter) : counter(counter), startUs(automation::microsecs()) {}
+      ~Scope() { counter.add(automation::microsecs() - startUs); }
+    };
+#endif
+
+  }
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef AUTOMATION_TIMER_WHEEL_H
+#define AUTOMATION_TIMER_WHEEL_H
+
+#include "Automation.h"
+
+#include <stdint.h>
+
+namespace automation {
+
+  // Hierarchical timer wheel.  Scheduling and cancelling are O(1) and advance() only visits timers that
+  // are due (plus an occasional cascade from a coarser level).  Timers are intrusive so nothing is
+  // allocated.  Timers fire from advance() which loop() calls so callbacks are not in interrupt context.
+  class TimerWheel {
+  public:
+    static const uint8_t TICK_SHIFT = 6; // 64ms ticks
+    static const uint8_t SLOT_BITS = 4, SLOT_CNT = 1 << SLOT_BITS, SLOT_MASK = SLOT_CNT - 1;
+    static const uint8_t LEVEL_CNT = 5; // 16^5 ticks is about 18 hours (longer timers are cascaded again)
+
+    typedef uint32_t Tick;
+
+    class Timer {
+    public:
+      virtual void expired() = 0;
+
+      bool isScheduled() const { return ppPrev != nullptr; }
+
+      virtual ~Timer() { unlink(); }
+
+    protected:
+      friend class TimerWheel;
+      Timer* pNext = nullptr;
+      Timer** ppPrev = nullptr; // address of the pointer to this timer (list head or previous timer)
+      Tick dueTick = 0;
+
+      void link(Timer** ppHead) {
+        pNext = *ppHead;
+        if ( pNext ) {
+          pNext->ppPrev = &pNext;
+        }
+        *ppHead = this;
+        ppPrev = ppHead;
+      }
+
+      void unlink() {
+        if ( ppPrev ) {
+          *ppPrev = pNext;
+          if ( pNext ) {
+            pNext->ppPrev = ppPrev;
+          }
+          ppPrev = nullptr;
+          pNext = nullptr;
+        }
+      }
+    };
+
+    static TimerWheel& instance() {
+      static TimerWheel wheel;
+      return wheel;
+    }
+
+    TimerWheel() : currentTick(0), bStarted(false) {
+      for ( uint8_t level = 0; level < LEVEL_CNT; level++ ) {
+        for ( uint8_t slot = 0; slot < SLOT_CNT; slot++ ) {
+          slots[level][slot] = nullptr;
+        }
+      }
+    }
+
+    // Reschedules the timer if it was already scheduled.  Never fires before dueMs.
+    void schedule(Timer& timer, TimerVal dueMs) {
+      start();
+      Tick dueTick = (dueMs + (1 << TICK_SHIFT) - 1) >> TICK_SHIFT;
+      timer.unlink();
+      timer.dueTick = dueTick > currentTick ? dueTick : currentTick + 1;
+      insert(timer);
+    }
+
+    void scheduleIn(Timer& timer, unsigned long delayMs) {
+      schedule(timer, millisecs64() + delayMs);
+    }
+
+    void cancel(Timer& timer) {
+      timer.unlink();
+    }
+
+    // Fire every timer due by nowMs.  Returns number of timers fired.
+    uint16_t advance(TimerVal nowMs = millisecs64()) {
+      start();
+      uint16_t firedCnt = 0;
+      Tick nowTick = nowMs >> TICK_SHIFT;
+      while ( (int32_t)(nowTick - currentTick) > 0 ) {
+        currentTick++;
+        for ( uint8_t level = LEVEL_CNT - 1; level > 0; level-- ) {
+          if ( (currentTick & ((1UL << (SLOT_BITS*level)) - 1)) == 0 ) {
+            cascade(level);
+          }
+        }
+        Timer** ppHead = &slots[0][currentTick & SLOT_MASK];
+        while ( *ppHead ) {
+          Timer* pTimer = *ppHead;
+          pTimer->unlink();
+          if ( (int32_t)(pTimer->dueTick - currentTick) > 0 ) {
+            insert(*pTimer); // beyond wheel range when scheduled
+          } else {
+            firedCnt++;
+            pTimer->expired(); // may reschedule itself
+          }
+        }
+      }
+      return firedCnt;
+    }
+
+  protected:
+    Timer* slots[LEVEL_CNT][SLOT_CNT];
+    Tick currentTick;
+    bool bStarted;
+
+    void start() {
+      if ( !bStarted ) {
+        currentTick = millisecs64() >> TICK_SHIFT;
+        bStarted = true;
+      }
+    }
+
+    void insert(Timer& timer) {
+      Tick delta = timer.dueTick - currentTick;
+      uint8_t level = 0;
+      while ( level < LEVEL_CNT - 1 && (delta >> (SLOT_BITS*(level+1))) != 0 ) {
+        level++;
+      }
+      Tick tick = timer.dueTick;
+      if ( (delta >> (SLOT_BITS*(level+1))) != 0 ) {
+        tick = currentTick + (1UL << (SLOT_BITS*LEVEL_CNT)) - 1; // park in last slot and cascade again
+      }
+      timer.link(&slots[level][(tick >> (SLOT_BITS*level)) & SLOT_MASK]);
+    }
+
+    void cascade(uint8_t level) {
+      Timer** ppHead = &slots[level][(currentTick >> (SLOT_BITS*level)) & SLOT_MASK];
+      while ( *ppHead ) {
+        Timer* pTimer = *ppHead;
+        pTimer->unlink();
+        insert(*pTimer);
+      }
+    }
+  };
+
+}
+
+#endif
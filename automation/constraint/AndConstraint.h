@@ -2,6 +2,7 @@
 #define AUTOMATION_ANDCONSTRAINT_H
 
 #include "CompositeConstraint.h"
+#include "ConstraintPlan.h"
 
 namespace automation {
 
@@ -13,21 +14,27 @@ namespace automation {
         CompositeConstraint("AND", constraints) {
     }
 
+    bool getDecisiveResult() const override { return false; }
+
     bool checkValue() override {
       bool bResult = true;
-      for (Constraint *pConstraint : children) {
-        if ( automation::bSynchronizing && !pConstraint->isSynchronizable() ) {
-          continue;
-        }
-        if (!pConstraint->test()) {
+      for (ChildIterator it(*this); !it.atEnd(); ++it) {
+        if (!testChild(it.getIndex())) {
           bResult = false;
           if ( bShortCircuit ) {
+            testDeferredChildren(it.getPos()+1);
             break;
           }
         }
       }
+      updateOrder();
       return bResult;
     }
+
+  protected:
+    void compileChildren(ConstraintPlan& plan) override {
+      compileJoined(plan, ConstraintPlan::JUMP_IF_FALSE, ConstraintPlan::AND);
+    }
   };
 }
 
@@ -20,6 +20,14 @@ namespace automation {
       return bResult;
     }
 
+    bool isInputChanged() override {
+      return false;
+    }
+
+    bool isInputPolled() override {
+      return false;
+    }
+
     string getTitle() const override {
       return bResult ? "PASS" : "FAIL";
     }
@@ -2,6 +2,7 @@
 #define AUTOMATION_COMPOSITECONSTRAINT_H
 
 #include "Constraint.h"
+#include "ConstraintPlan.h"
 #include "../Automation.h"
 
 #include <vector>
@@ -11,12 +12,121 @@ namespace automation {
 
   class CompositeConstraint : public Constraint {
   public:
+    static const uint8_t ORDER_UPDATE_INTERVAL = 16; // checkValue() calls between reordering
+    static const uint16_t MAX_STAT_CNT = 1000;       // counts are halved here so stats follow recent behavior
+
+    // Per child (same index as children).  A decisive result is one that settles the composite on its own
+    // (false for AND, true for OR).
+    struct ChildStats {
+      uint16_t costUs = 0;      // smoothed test() duration
+      uint16_t testCnt = 0;
+      uint16_t decisiveCnt = 0;
+
+      // expected test() time spent per decisive result
+      float getRank() const { return (costUs + 1.0f) * (testCnt + 2) / (decisiveCnt + 1); }
+    };
+
     string strJoinName;
-    bool bShortCircuit = false;
 
     CompositeConstraint(const string &strJoinName, const vector<Constraint *> &constraints) : 
         Constraint(constraints),
-        strJoinName(strJoinName) {
+        strJoinName(strJoinName),
+        childStats(constraints.size()) {
+      for (size_t i = 0; i < constraints.size(); i++) {
+        order.push_back(i);
+      }
+    }
+
+    // Result of a child that decides the composite result without testing the others
+    virtual bool getDecisiveResult() const = 0;
+
+    const ChildStats& getChildStats(uint8_t i) const { return childStats[i]; }
+
+    bool isShortCircuit() const { return bShortCircuit; }
+    bool isAdaptiveOrder() const { return bAdaptiveOrder; }
+
+    // Both change the code of compiled plans so plans containing this composite recompile
+    CompositeConstraint& setShortCircuit(bool bShortCircuit) {
+      this->bShortCircuit = bShortCircuit;
+      setDirty();
+      ConstraintPlan::invalidateAll();
+      return *this;
+    }
+
+    CompositeConstraint& setAdaptiveOrder(bool bAdaptiveOrder) {
+      this->bAdaptiveOrder = bAdaptiveOrder;
+      if ( !bAdaptiveOrder ) {
+        resetOrder();
+      }
+      setDirty();
+      ConstraintPlan::invalidateAll();
+      return *this;
+    }
+
+    // Walks children in evaluation order skipping those not synchronizable while synchronizing.  Nothing is 
+    // copied so checkValue() does not allocate.
+    class ChildIterator {
+    public:
+      ChildIterator(const CompositeConstraint& composite, uint8_t pos = 0) : composite(composite), pos(pos) {
+        skipExcluded();
+      }
+
+      bool atEnd() const { return pos >= composite.order.size(); }
+      uint8_t getPos() const { return pos; }
+      uint8_t getIndex() const { return composite.order[pos]; }
+      Constraint* operator*() const { return composite.children[getIndex()]; }
+
+      ChildIterator& operator++() {
+        pos++;
+        skipExcluded();
+        return *this;
+      }
+
+    protected:
+      const CompositeConstraint& composite;
+      uint8_t pos;
+
+      void skipExcluded() {
+        while ( !atEnd() && automation::bSynchronizing && !(**this)->isSynchronizable() ) {
+          pos++;
+        }
+      }
+    };
+
+    // Compiled plans do not inline the children of an adaptive composite.  It is a single node tested
+    // through test() so children are evaluated in the current order and their stats are kept.
+    void compile(ConstraintPlan& plan) override {
+      if ( bAdaptiveOrder ) {
+        Constraint::compile(plan);
+      } else {
+        compileChildren(plan);
+      }
+    }
+
+    SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream = nullptr) override {
+      SetCode rtn = Constraint::setAttribute(pszKey,pszVal,pRespStream);
+      if ( rtn == SetCode::Ignored ) {
+        bool bFlag = text::parseBool(pszVal);
+        if ( !strcasecmp_P(pszKey,PSTR("shortCircuit")) ) {
+          setShortCircuit(bFlag);
+          rtn = SetCode::OK;
+        } else if ( !strcasecmp_P(pszKey,PSTR("adaptiveOrder")) ) {
+          setAdaptiveOrder(bFlag);
+          rtn = SetCode::OK;
+        }
+        if (pRespStream && rtn == SetCode::OK ) {
+          (*pRespStream) << "'" << getTitle() << "' " << pszKey << "=" << text::boolAsString(bFlag);
+        }
+      }
+      return rtn;
+    }
+
+    bool isInputChanged() override {
+      return isChildInputChanged();
+    }
+
+    bool isInputPolled() override {
+      return bPolledChild;
     }
 
     string getTitle() const override {
@@ -35,7 +145,121 @@ namespace automation {
 
     virtual void printVerboseExtra(json::JsonStreamWriter& w) const override {
       w.printlnBoolObj(F("shortCircuit"),bShortCircuit,",");
+      w.printlnBoolObj(F("adaptiveOrder"),bAdaptiveOrder,",");
       w.printlnStringObj(F("joinName"),strJoinName,",");
+      w.printKey(F("evaluationOrder")); // children with their stats
+      w.noPrefixPrintln("[");
+      w.increaseDepth();
+      for (size_t pos = 0; pos < order.size(); pos++) {
+        uint8_t i = order[pos];
+        const ChildStats& stats = childStats[i];
+        w.println("{");
+        w.increaseDepth();
+        w.printlnNumberObj(F("id"), (unsigned long) children[i]->id, ",");
+        w.printlnNumberObj(F("costUs"), stats.costUs, ",");
+        w.printlnNumberObj(F("testCnt"), stats.testCnt, ",");
+        w.printlnNumberObj(F("decisiveCnt"), stats.decisiveCnt);
+        w.decreaseDepth();
+        w.print("}");
+        w.noPrefixPrintln(pos + 1 < order.size() ? "," : "");
+      }
+      w.decreaseDepth();
+      w.println("],");
+    }
+
+  protected:
+    bool bShortCircuit = false;
+
+    // With bShortCircuit, evaluate children lowest rank first so cheap and decisive children skip the rest
+    bool bAdaptiveOrder = false;
+
+    vector<ChildStats> childStats;
+    vector<uint8_t> order; // child indexes in evaluation order
+    uint8_t checkCnt = 0;
+
+    virtual void compileChildren(ConstraintPlan& plan) = 0;
+
+    // Children in post-order joined by combineOp.  Before each child after the first, shortCircuitOp jumps
+    // to END if the result so far is decisive.  Without children AND and OR both pass (see checkValue()).
+    void compileJoined(ConstraintPlan& plan, ConstraintPlan::Opcode shortCircuitOp, ConstraintPlan::Opcode combineOp) {
+      uint8_t self = plan.addConstraint(this);
+      size_t begin = plan.emit(ConstraintPlan::BEGIN, self);
+      if ( children.empty() ) {
+        plan.emit(ConstraintPlan::PUSH, true);
+      }
+      std::vector<size_t> shortCircuits;
+      for (size_t i = 0; i < children.size(); i++) {
+        if ( i > 0 && bShortCircuit ) {
+          shortCircuits.push_back(plan.emit(shortCircuitOp));
+        }
+        children[i]->compile(plan);
+        if ( i > 0 ) {
+          plan.emit(combineOp); // first child result is the start value
+        }
+      }
+      for ( size_t at : shortCircuits ) {
+        plan.setTargetToNext(at);
+      }
+      plan.emit(ConstraintPlan::END, self);
+      plan.setTargetToNext(begin);
+    }
+
+
+    bool testChild(uint8_t i) {
+      unsigned long startUs = automation::microsecs();
+      bool bResult = children[i]->test();
+      unsigned long elapsedUs = automation::microsecs() - startUs;
+      uint16_t costUs = elapsedUs > 0xFFFF ? 0xFFFF : elapsedUs;
+      ChildStats& stats = childStats[i];
+      if ( stats.testCnt >= MAX_STAT_CNT ) {
+        stats.testCnt /= 2;
+        stats.decisiveCnt /= 2;
+      }
+      stats.costUs = stats.testCnt ? stats.costUs + ((long)costUs - stats.costUs) / 4 : costUs;
+      stats.testCnt++;
+      if ( bResult == getDecisiveResult() ) {
+        stats.decisiveCnt++;
+      }
+      return bResult;
+    }
+
+    // After a short circuit, children skipped because of their position in the order still need testing if
+    // a deferred result is in progress.  Otherwise the deferral would be resolved later from a stale start 
+    // time (a condition that did not hold for the whole delay) or cancelled late.
+    void testDeferredChildren(uint8_t fromPos) {
+      if ( !bAdaptiveOrder ) {
+        return;
+      }
+      for (ChildIterator it(*this, fromPos); !it.atEnd(); ++it) {
+        if ( (*it)->isDeferred() ) {
+          testChild(it.getIndex());
+        }
+      }
+    }
+
+    // Stable insertion sort by rank.  A child only moves ahead when clearly cheaper per decisive result so 
+    // children with similar ranks do not swap back and forth.
+    void updateOrder() {
+      if ( !bAdaptiveOrder || ++checkCnt < ORDER_UPDATE_INTERVAL ) {
+        return;
+      }
+      checkCnt = 0;
+      for (size_t pos = 1; pos < order.size(); pos++) {
+        uint8_t i = order[pos];
+        float rank = childStats[i].getRank();
+        size_t insertPos = pos;
+        while ( insertPos > 0 && rank < 0.8f * childStats[order[insertPos-1]].getRank() ) {
+          order[insertPos] = order[insertPos-1];
+          insertPos--;
+        }
+        order[insertPos] = i;
+      }
+    }
+
+    void resetOrder() {
+      for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+      }
     }
 
   };
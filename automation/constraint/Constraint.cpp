@@ -1,6 +1,7 @@
 
 #include "Constraint.h"
 #include "ConstraintEventHandler.h"
+#include "ConstraintPlan.h"
 
 #include "../json/JsonStreamWriter.h"
 
@@ -9,9 +10,38 @@ namespace automation {
 
   bool Constraint::test()
   {
-    if ( !bEnabled ) {
+    if ( !beginTest() ) {
       return bPassed;
     }
+    return endTest(checkValue());
+  }
+
+  // testProfile runs from beginTest() to endTest() so compiled plans are counted the same as test()
+  bool Constraint::beginTest()
+  {
+    PROFILE_START(testStartUs)
+    if ( !beginCheck() ) {
+      PROFILE_STOP(testProfile,testStartUs)
+      return false;
+    }
+    return true;
+  }
+
+  bool Constraint::beginCheck()
+  {
+    if ( !bEnabled ) {
+      return false;
+    }
+    if ( isEvaluating() ) {
+      if ( testedEpoch == evaluationEpoch() ) {
+        return false; // already tested this pass (shared constraint)
+      }
+      testedEpoch = evaluationEpoch();
+    }
+    if ( !isTestRequired() ) {
+      return false;
+    }
+    bDirty = false;
     Mode resolvedMode = mode;
     if ( mode != TEST_MODE ) {
       if (mode&REMOTE_MODE) {
@@ -21,20 +51,26 @@ namespace automation {
           if ( resolvedMode == 0 ) {
             // just return old result if REMOTE with no qualifiers
             checkValue(); // composite and nested constraints need checkValue call for deferred state tracking
-            return bPassed;
+            return false;
           }
         } else {            
           // honor value set remotely but call checkValue to update transition and delay states
           checkValue(); // composite and nested constraints need checkValue call for deferred state tracking
-          return bPassed;
+          return false;
         }
       }
       if ( resolvedMode == PASS_MODE || resolvedMode == FAIL_MODE || resolvedMode == INVALID_MODE ) {
-        return overrideTestResult( resolvedMode == PASS_MODE );
+        overrideTestResult( resolvedMode == PASS_MODE );
+        return false;
       }
     }
+    return true;
+  }
+
+  bool Constraint::endTest(bool bCheckPassed)
+  {
 
-    bool bCheckPassed = checkValue();
+    updateCheckedChildren();
 
     if ( !deferredTimeMs ) {
       // first test so ignore delays on changing state
@@ -72,15 +108,41 @@ namespace automation {
     if ( deferredResultCnt == 1 ) {
       ConstraintEventHandlerList::instance.resultDeferred(this,bCheckPassed,bCheckPassed?passDelayMs:failDelayMs);
     }
+    updateDeferralTimer();
 
+    PROFILE_STOP(testProfile,testStartUs)
     return bPassed;
   }
 
+  void Constraint::compile(ConstraintPlan& plan) {
+    plan.emit(ConstraintPlan::TEST, plan.addConstraint(this));
+  }
+
+  void Constraint::updateDeferralTimer() {
+    if ( deferredResultCnt == 0 ) {
+      TimerWheel::instance().cancel(deferralTimer);
+      return;
+    }
+    unsigned long delayMs = bPassed ? failDelayMs : passDelayMs;
+    unsigned long elapsedMs = deferredDuration();
+    TimerWheel::instance().scheduleIn(deferralTimer, elapsedMs < delayMs ? delayMs - elapsedMs : 0);
+  }
+
+  void Constraint::DeferralTimer::expired() {
+    constraint.setDirty();
+    Constraints::requestEvaluation();
+  }
+
+  void Constraint::RemoteExpiredDelayOp::ExpiryTimer::expired() {
+    Constraints::requestEvaluation();
+  }
+
 
   void Constraint::setPassed(bool bPassed) {
     if ( bPassed != this->bPassed ) {
       deferredResultCnt = 0;
       this->bPassed = bPassed;
+      resultChangeCnt++;
       unsigned long durationMs = automation::millisecs()-changeTimeMs;
       ConstraintEventHandlerList::instance.resultChanged(this,bPassed,durationMs);
       listeners.resultChanged(this,bPassed,durationMs);
@@ -112,6 +174,7 @@ namespace automation {
           if ( mode & (FAIL_MODE|PASS_MODE) ) {
             overrideTestResult(mode&PASS_MODE); // do not wait for transition delays
           } else {
+            setDirty();
             test();
           }          
           rtn = SetCode::OK;
@@ -129,6 +192,7 @@ namespace automation {
         strResultValue = text::boolAsString(bEnabled);
         rtn = SetCode::OK;
       } else if ( !strcasecmp_P(pszKey,PSTR("PASSED")) ) {
+        pRemoteExpiredOp->reset(); // remote value set so its expiration starts now
         overrideTestResult(text::parseBool(pszVal));
         strResultValue = text::boolAsString(isPassed());
         rtn = SetCode::OK;
@@ -170,6 +234,9 @@ namespace automation {
           rtn = SetCode::Error;
         }
       }
+      if ( rtn == SetCode::OK ) {
+        setDirty();
+      }
       if (pRespStream && rtn == SetCode::OK ) {
         if (pRespStream->rdbuf()->in_avail()) {
           (*pRespStream) << ", ";
@@ -4,17 +4,22 @@
 #include "../Automation.h"
 #include "../json/JsonStreamWriter.h"
 #include "../AttributeContainer.h"
+#include "../Profiler.h"
+#include "../TimerWheel.h"
 #include "ConstraintEventHandler.h"
 
 #include <string>
 #include <iostream>
 #include <string.h>
 #include <set>
+#include <algorithm>
 
 using namespace std;
 
 namespace automation {
 
+  class ConstraintPlan;
+
   class Constraint : public AttributeContainer {
 
     public:
@@ -67,6 +72,19 @@ namespace automation {
       return all;
     }    
 
+    // Incremented once per evaluation pass (see Constraints::beginEvaluation) so constraints shared by 
+    // several devices or parents are only tested once per pass.  Outside a pass (commands) every 
+    // test() is evaluated.
+    static unsigned long& evaluationEpoch() {
+      static unsigned long epoch = 1;
+      return epoch;
+    }
+
+    static bool& isEvaluating() {
+      static bool bEvaluating = false;
+      return bEvaluating;
+    }
+
     Mode mode = TEST_MODE;
 
     bool bEnabled = true;
@@ -80,10 +98,17 @@ namespace automation {
         children(children){
       assignId(this);
       all().insert(this);
+      for ( Constraint* pChild : children ) {
+        pChild->parents.push_back(this);
+      }
     }
 
     virtual ~Constraint() {
       all().erase(this);
+      for ( Constraint* pChild : children ) {
+        vector<Constraint*>& childParents = pChild->parents;
+        childParents.erase(std::remove(childParents.begin(), childParents.end(), this), childParents.end());
+      }
       if ( pRemoteExpiredOp != &defaultRemoteExpiredOp ) {
         delete pRemoteExpiredOp;
       }
@@ -93,8 +118,41 @@ namespace automation {
     virtual string getTitle() const { return getType(); }
     virtual bool isSynchronizable() const { return true; }
     virtual bool test();
+    PROFILE_COUNTER(testProfile)
+    PROFILE_START_US(testStartUs)
+
+    // Append instructions that evaluate this constraint to a plan (default calls test())
+    virtual void compile(ConstraintPlan& plan);
+
+    // test() skips checkValue() when nothing the last result depended on can have changed.  Inputs that 
+    // report their changes (sensor epochs, timers, attributes) call setDirty().  Polled inputs (time, 
+    // capability values) are asked here on every pass... time based constraints keep the default.
+    virtual bool isInputChanged() { return true; }
+
+    // False when every input change calls setDirty() so parents do not need to ask isInputChanged()
+    virtual bool isInputPolled() { return true; }
+
+    bool isPolled() { return mode != TEST_MODE || isInputPolled(); }
+
+    // A deferred result with unchanged inputs does not need testing until deferralTimer fires
+    bool isTestRequired() {
+      return bDirty || !deferredTimeMs || mode != TEST_MODE || automation::bSynchronizing || isInputChanged();
+    }
+
+    // Force the next test() to call checkValue() (attribute and input changes).  Parents are marked too
+    // so they test again without visiting every descendant.
+    void setDirty() {
+      bDirty = true;
+      for ( Constraint* pParent : parents ) {
+        pParent->setDirty();
+      }
+    }
+
+    uint8_t getResultChangeCnt() const { return resultChangeCnt; }
     
     struct RemoteExpiredOp {
+
+      virtual ~RemoteExpiredOp() {} // delay op owns a wheel timer that must unlink itself
       
       virtual bool test() { 
         // use global expiration based on last time a remote command was processed
@@ -119,6 +177,11 @@ namespace automation {
       unsigned long delayMs;
       unsigned long attributeSetTimeMs; // each constraints remote status will expire individualy after a delay
 
+      // Requests an evaluation pass when the remote value expires instead of waiting for the next refresh
+      struct ExpiryTimer : public TimerWheel::Timer {
+        void expired() override;
+      } expiryTimer;
+
       RemoteExpiredDelayOp( unsigned long delayMs ) : delayMs(delayMs), attributeSetTimeMs(0) {}
       
       bool test() override {
@@ -127,6 +190,7 @@ namespace automation {
 
       void reset() override {
         attributeSetTimeMs = automation::millisecs();
+        TimerWheel::instance().scheduleIn(expiryTimer, delayMs + 1);
       }
 
       virtual void print(json::JsonStreamWriter& w) override {
@@ -154,21 +218,25 @@ namespace automation {
 
     Constraint& setPassDelayMs(unsigned long delayMs) {
       passDelayMs = delayMs;
+      setDirty();
       return *this;
     }
     
     Constraint& setFailDelayMs(unsigned long delayMs) {
       failDelayMs = delayMs;
+      setDirty();
       return *this;
     }
 
     Constraint& setPassMargin(float passMargin) {
       this->passMargin = passMargin;
+      setDirty();
       return *this;
     }
 
     Constraint& setFailMargin(float margin) {
       this->failMargin = margin;
+      setDirty();
       return *this;
     }
 
@@ -202,14 +270,75 @@ namespace automation {
     ConstraintEventHandlerList listeners;
 
     protected:
+    friend class ConstraintPlan;
 
     vector<Constraint *> children;
+    vector<Constraint *> parents; // marked by setDirty()
     bool bPassed = false;
     unsigned long deferredTimeMs = 0, changeTimeMs { automation::millisecs() };
     unsigned int deferredResultCnt = 0;
     float passMargin = 0;
     float failMargin = 0;
+    bool bDirty = true;
+    unsigned long testedEpoch = 0;
+
+    // Fires when a deferred pass or fail is due so the constraint is tested on time
+    struct DeferralTimer : public TimerWheel::Timer {
+      Constraint& constraint;
+      DeferralTimer(Constraint& constraint) : constraint(constraint) {}
+      void expired() override;
+    } deferralTimer {*this};
+
+    void updateDeferralTimer();
+
+    // test() is beginTest() then endTest(checkValue()).  Split so ConstraintPlan can evaluate children
+    // inline with the same deferral handling.  beginTest() returns false if checkValue() is not needed.
+    bool beginTest();
+    bool endTest(bool bCheckPassed);
+    bool beginCheck(); // beginTest() without profiling
+    uint8_t resultChangeCnt = 0; // parents compare the sum of these to see if a child result changed
+    uint8_t checkedChildChangeSum = 0;
+    bool bPolledChild = true; // an enabled child was polled when last checked
     void setPassed(bool bPassed);
+
+    void addChild(Constraint* pChild) {
+      children.push_back(pChild);
+      pChild->parents.push_back(this);
+    }
+
+    uint8_t getChildChangeSum() const {
+      uint8_t sum = 0;
+      for ( Constraint* pChild : children ) {
+        sum += pChild->resultChangeCnt;
+      }
+      return sum;
+    }
+
+    // Called by endTest() so parents know what the children were when checked
+    void updateCheckedChildren() {
+      checkedChildChangeSum = 0;
+      bPolledChild = false;
+      for ( Constraint* pChild : children ) {
+        checkedChildChangeSum += pChild->resultChangeCnt;
+        bPolledChild = bPolledChild || (pChild->bEnabled && pChild->isPolled());
+      }
+    }
+
+    // For constraints whose result only depends on their children.  Children whose inputs changed have 
+    // already marked this constraint dirty so only polled children are asked.
+    bool isChildInputChanged() {
+      if ( getChildChangeSum() != checkedChildChangeSum ) {
+        return true;
+      }
+      if ( bPolledChild ) {
+        for ( Constraint* pChild : children ) {
+          if ( pChild->bEnabled && pChild->isPolled() && pChild->isTestRequired() ) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
     
     unsigned long deferredDuration() const {
         unsigned long nowMs = millisecs();
@@ -232,6 +361,25 @@ namespace automation {
       return timer.getMaxDurationMs() != 0 && !timer.isExpired();
     }
 
+    static void beginEvaluation() {
+      Constraint::evaluationEpoch()++;
+      Constraint::isEvaluating() = true;
+    }
+
+    static void endEvaluation() {
+      Constraint::isEvaluating() = false;
+    }
+
+    // Timers (deferrals and remote expiry) ask loop() for an evaluation pass before the next refresh
+    static bool& isEvaluationRequested() {
+      static bool bRequested = false;
+      return bRequested;
+    }
+
+    static void requestEvaluation() {
+      isEvaluationRequested() = true;
+    }
+
     Constraints(){}
     Constraints( vector<Constraint*>& constraints ) : AttributeContainerVector<Constraint*>(constraints) {}
     Constraints( vector<Constraint*> constraints ) : AttributeContainerVector<Constraint*>(constraints) {}
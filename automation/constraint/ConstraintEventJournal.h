@@ -0,0 +1,126 @@
+#ifndef AUTOMATION_CONSTRAINT_EVENT_JOURNAL_H
+#define AUTOMATION_CONSTRAINT_EVENT_JOURNAL_H
+
+#include "Constraint.h"
+#include "ConstraintEventHandler.h"
+#include "../json/JsonStreamWriter.h"
+
+#include <stdint.h>
+
+namespace automation {
+
+  // Ring buffer of recent constraint result changes and deferrals so a client can ask for the events since
+  // the last sequence number it saw instead of polling fast enough to catch every transition.
+  class ConstraintEventJournal : public ConstraintEventHandler {
+  public:
+    static const uint8_t CAPACITY = 24;
+
+    enum EventType : uint8_t { RESULT_CHANGED, RESULT_DEFERRED, DEFERRAL_CANCELLED };
+
+    struct Event {
+      NumericIdentifierValue constraintId;
+      uint8_t flags; // EventType in low bits and PASSED_FLAG
+      uint32_t durationMs; // time in previous state (delay for RESULT_DEFERRED)
+      uint32_t timeMs;
+
+      static const uint8_t TYPE_MASK = 0x03, PASSED_FLAG = 0x80;
+
+      EventType getType() const { return (EventType) (flags & TYPE_MASK); }
+      bool isPassed() const { return flags & PASSED_FLAG; }
+    };
+
+    // Registered with ConstraintEventHandlerList::instance on first use
+    static ConstraintEventJournal& instance() {
+      static ConstraintEventJournal journal;
+      return journal;
+    }
+
+    void resultChanged(Constraint* pConstraint,bool bNew,unsigned long lastDurationMs) const override {
+      add(pConstraint,RESULT_CHANGED,bNew,lastDurationMs);
+    }
+
+    void resultDeferred(Constraint* pConstraint,bool bNew,unsigned long delayMs) const override {
+      add(pConstraint,RESULT_DEFERRED,bNew,delayMs);
+    }
+
+    void deferralCancelled(Constraint* pConstraint,bool bNew,unsigned long lastDurationMs) const override {
+      add(pConstraint,DEFERRAL_CANCELLED,bNew,lastDurationMs);
+    }
+
+    // Sequence numbers start at 1 so 0 asks for everything still in the journal
+    uint32_t getLastSeq() const { return lastSeq; }
+    uint32_t getFirstSeq() const { return lastSeq - count + 1; }
+
+    static const char* typeAsString(EventType type) {
+      switch (type) {
+        case RESULT_CHANGED: return "changed";
+        case RESULT_DEFERRED: return "deferred";
+        default: return "cancelled";
+      }
+    }
+
+    // Events after sinceSeq.  droppedCnt is how many of those were overwritten before being read.
+    void print(json::JsonStreamWriter& w, uint32_t sinceSeq) const {
+      if ( sinceSeq > lastSeq ) {
+        sinceSeq = 0; // client has sequence numbers from before a restart
+      }
+      uint32_t firstSeq = getFirstSeq();
+      uint32_t fromSeq = sinceSeq + 1 > firstSeq ? sinceSeq + 1 : firstSeq;
+      w.noPrefixPrintln("{");
+      w.increaseDepth();
+      w.printlnNumberObj(F("lastSeq"), (unsigned long) lastSeq, ",");
+      w.printlnNumberObj(F("droppedCnt"), (unsigned long) (sinceSeq + 1 < firstSeq ? firstSeq - sinceSeq - 1 : 0), ",");
+      w.printlnNumberObj(F("timeMs"), (unsigned long) automation::millisecs(), ",");
+      w.printKey(F("events"));
+      w.noPrefixPrintln("[");
+      w.increaseDepth();
+      for ( uint32_t seq = fromSeq; seq <= lastSeq; seq++ ) {
+        const Event& e = events[(next + CAPACITY - (lastSeq - seq) - 1) % CAPACITY];
+        w.print("{");
+        w.noPrefixPrint("\"seq\": ");
+        w.noPrefixPrint((unsigned long) seq);
+        w.noPrefixPrint(", \"id\": ");
+        w.noPrefixPrint((unsigned long) e.constraintId);
+        w.noPrefixPrint(", \"type\": \"");
+        w.noPrefixPrint(typeAsString(e.getType()));
+        w.noPrefixPrint("\", \"passed\": ");
+        w.noPrefixPrint(e.isPassed() ? "true" : "false");
+        w.noPrefixPrint(", \"durationMs\": ");
+        w.noPrefixPrint((unsigned long) e.durationMs);
+        w.noPrefixPrint(", \"timeMs\": ");
+        w.noPrefixPrint((unsigned long) e.timeMs);
+        w.noPrefixPrint("}");
+        w.noPrefixPrintln(seq < lastSeq ? "," : "");
+      }
+      w.decreaseDepth();
+      w.println("]");
+      w.decreaseDepth();
+      w.print("}");
+    }
+
+  protected:
+    mutable Event events[CAPACITY];
+    mutable uint8_t next = 0;  // ring index for the next event
+    mutable uint8_t count = 0;
+    mutable uint32_t lastSeq = 0;
+
+    ConstraintEventJournal() {
+      ConstraintEventHandlerList::instance.add(this);
+    }
+
+    void add(Constraint* pConstraint, EventType type, bool bPassed, unsigned long durationMs) const {
+      Event& e = events[next];
+      e.constraintId = pConstraint->id;
+      e.flags = type | (bPassed ? Event::PASSED_FLAG : 0);
+      e.durationMs = durationMs;
+      e.timeMs = automation::millisecs();
+      next = (next + 1) % CAPACITY;
+      if ( count < CAPACITY ) {
+        count++;
+      }
+      lastSeq++;
+    }
+  };
+
+}
+#endif
@@ -0,0 +1,207 @@
+#ifndef AUTOMATION_CONSTRAINT_PLAN_H
+#define AUTOMATION_CONSTRAINT_PLAN_H
+
+#include "Constraint.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace automation {
+
+  // Constraint tree lowered to a post-order instruction array so AND, OR and NOT nodes are evaluated in 
+  // one loop instead of recursive test()/checkValue() calls.  Leaves (and any node type without its own
+  // compile()) are still tested through test().  Composite nodes go through the same beginTest()/endTest()
+  // as test() so deferrals, modes, memoization and events behave the same as the recursive path.  The
+  // first child of AND/OR starts the result and NOT is folded into its END so each node costs few steps.
+  // Most of an evaluation is that shared bookkeeping so a plan is not faster than test() on the host
+  // benchmark (tests/host/ConstraintPlanTest)... plans are opt-in (Device::compileConstraint()).
+  class ConstraintPlan {
+  public:
+    enum Opcode : uint8_t {
+      TEST,          // push constraints[a]->test()
+      BEGIN,         // if constraints[a] does not need checkValue() push its result and jump to b
+      PUSH,          // push a (result of an AND or OR without children)
+      AND,           // pop two and push AND
+      OR,            // pop two and push OR
+      JUMP_IF_FALSE, // short circuit to a (top is kept)
+      JUMP_IF_TRUE,
+      END            // top is check result of constraints[a]... replace with constraints[a]->endTest(top != b)
+    };
+
+    struct Instruction {
+      Opcode op;
+      uint8_t a, b;
+    };
+
+    static const uint8_t MAX_STACK_DEPTH = 32; // stack is bits of a uint32_t
+    static const uint16_t MAX_INSTRUCTIONS = 255; // jump targets are 8 bits
+
+    // Bumped when a constraint changes how it compiles (adaptive order turned on/off) so plans recompile
+    static uint8_t& version() {
+      static uint8_t version = 0;
+      return version;
+    }
+
+    static void invalidateAll() { version()++; }
+
+    ConstraintPlan() {}
+
+    ConstraintPlan(Constraint* pRoot) {
+      compile(pRoot);
+    }
+
+    // Returns false if the tree does not fit (run() then uses the recursive test())
+    bool compile(Constraint* pRoot) {
+      this->pRoot = pRoot;
+      compiledVersion = version();
+      code.clear();
+      constraints.clear();
+      bValid = pRoot != nullptr;
+      if ( bValid ) {
+        pRoot->compile(*this);
+      }
+      if ( !bValid || code.size() > MAX_INSTRUCTIONS || getMaxStackDepth() > MAX_STACK_DEPTH ) {
+        code.clear();
+        constraints.clear();
+        bValid = false;
+      }
+      return bValid;
+    }
+
+    bool isValid() const { return bValid; }
+    size_t size() const { return code.size(); }
+
+    uint8_t addConstraint(Constraint* pConstraint) {
+      for ( size_t i = 0; i < constraints.size(); i++ ) {
+        if ( constraints[i] == pConstraint ) {
+          return i;
+        }
+      }
+      if ( constraints.size() > 255 ) {
+        bValid = false;
+        return 0;
+      }
+      constraints.push_back(pConstraint);
+      return constraints.size() - 1;
+    }
+
+    size_t emit(Opcode op, uint8_t a = 0, uint8_t b = 0) {
+      Instruction instruction = { op, a, b };
+      code.push_back(instruction);
+      return code.size() - 1;
+    }
+
+    // Point BEGIN or jump instruction at the next instruction to be emitted
+    void setTargetToNext(size_t at) {
+      uint8_t target = code.size();
+      if ( code[at].op == BEGIN ) {
+        code[at].b = target;
+      } else {
+        code[at].a = target;
+      }
+    }
+
+    bool run() {
+      if ( compiledVersion != version() ) {
+        compile(pRoot);
+      }
+      if ( !bValid || automation::bSynchronizing ) {
+        return pRoot ? pRoot->test() : false; // composites skip constraints that are not synchronizable
+      }
+      uint32_t stack = 0;
+      uint8_t sp = 0;
+      const Instruction* pCode = &code[0];
+      Constraint* const* pConstraints = &constraints[0];
+      const uint8_t codeSize = code.size();
+      for ( uint8_t pc = 0; pc < codeSize; ) {
+        const Instruction& in = pCode[pc++];
+        switch (in.op) {
+          case TEST:
+            push(stack, sp, pConstraints[in.a]->test());
+            break;
+          case BEGIN: {
+            Constraint* pConstraint = pConstraints[in.a];
+            if ( !pConstraint->beginTest() ) {
+              push(stack, sp, pConstraint->bPassed);
+              pc = in.b;
+            }
+            break;
+          }
+          case PUSH:
+            push(stack, sp, in.a);
+            break;
+          case AND: {
+            bool bRight = pop(stack, sp);
+            bool bLeft = pop(stack, sp);
+            push(stack, sp, bLeft && bRight);
+            break;
+          }
+          case OR: {
+            bool bRight = pop(stack, sp);
+            bool bLeft = pop(stack, sp);
+            push(stack, sp, bLeft || bRight);
+            break;
+          }
+          case JUMP_IF_FALSE:
+            if ( !top(stack, sp) ) {
+              pc = in.a;
+            }
+            break;
+          case JUMP_IF_TRUE:
+            if ( top(stack, sp) ) {
+              pc = in.a;
+            }
+            break;
+          case END:
+            push(stack, sp, pConstraints[in.a]->endTest(pop(stack, sp) != in.b));
+            break;
+        }
+      }
+      return top(stack, sp);
+    }
+
+  protected:
+    Constraint* pRoot = nullptr;
+    std::vector<Instruction> code;
+    std::vector<Constraint*> constraints;
+    bool bValid = false;
+    uint8_t compiledVersion = 0;
+
+    static void push(uint32_t& stack, uint8_t& sp, bool bVal) {
+      if ( bVal ) {
+        stack |= (1UL << sp);
+      } else {
+        stack &= ~(1UL << sp);
+      }
+      sp++;
+    }
+
+    static bool pop(uint32_t& stack, uint8_t& sp) {
+      sp--;
+      return (stack >> sp) & 1;
+    }
+
+    static bool top(uint32_t stack, uint8_t sp) {
+      return (stack >> (sp - 1)) & 1;
+    }
+
+    // Jumps land where the fall through path has the same depth so a linear scan is enough
+    uint8_t getMaxStackDepth() const {
+      int depth = 0, maxDepth = 0;
+      for ( const Instruction& in : code ) {
+        if ( in.op == TEST || in.op == PUSH ) {
+          depth++;
+        } else if ( in.op == AND || in.op == OR ) {
+          depth--;
+        }
+        if ( depth > maxDepth ) {
+          maxDepth = depth;
+        }
+      }
+      return maxDepth > 255 ? 255 : maxDepth;
+    }
+  };
+
+}
+
+#endif
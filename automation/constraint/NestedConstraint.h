@@ -8,7 +8,7 @@ namespace automation {
   class NestedConstraint : public Constraint {
   public:
     explicit NestedConstraint(Constraint *pConstraint) {
-      children.push_back(pConstraint);
+      addChild(pConstraint);
     }
 
     virtual bool outerCheckValue(bool bInnerResult) = 0;
@@ -18,6 +18,14 @@ namespace automation {
       //return outerCheckValue(pConstraint->checkValue());
     }
 
+    bool isInputChanged() override {
+      return isChildInputChanged();
+    }
+
+    bool isInputPolled() override {
+      return bPolledChild;
+    }
+
     Constraint* inner() const {
       return children[0];
     }
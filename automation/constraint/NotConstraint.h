@@ -3,6 +3,7 @@
 
 #include "Constraint.h"
 #include "NestedConstraint.h"
+#include "ConstraintPlan.h"
 
 namespace automation {
 
@@ -16,6 +17,14 @@ namespace automation {
     bool outerCheckValue(bool bInnerResult) override {
       return !bInnerResult;
     }
+
+    void compile(ConstraintPlan& plan) override {
+      uint8_t self = plan.addConstraint(this);
+      size_t begin = plan.emit(ConstraintPlan::BEGIN, self);
+      inner()->compile(plan);
+      plan.emit(ConstraintPlan::END, self, true); // inverts the inner result
+      plan.setTargetToNext(begin);
+    }
   };
 
 }
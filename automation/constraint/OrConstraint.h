@@ -2,6 +2,7 @@
 #define AUTOMATION_ORCONSTRAINT_H
 
 #include "CompositeConstraint.h"
+#include "ConstraintPlan.h"
 
 #include <algorithm>
 
@@ -15,26 +16,28 @@ namespace automation {
         CompositeConstraint("OR", constraints) {
     }
 
+    bool getDecisiveResult() const override { return true; }
+
     bool checkValue() override {
-      vector<Constraint*> filteredConstraints;
-      //copy_if not supported in ArduinoSTL
-      //auto filter = [](Constraint* pConstraint)->bool{ return !(automation::bSynchronizing && !pConstraint->isSynchronizable()); };
-      //std::copy_if(constraints.begin(), constraints.end(), std::back_inserter(filteredConstraints), filter);
-      for(Constraint* c: children){
-        if ( !(automation::bSynchronizing && !c->isSynchronizable()) )
-          filteredConstraints.push_back(c);
-      }
-      bool bResult = filteredConstraints.empty();
-      for (Constraint *pConstraint : filteredConstraints) {
-        if (pConstraint->test()) {
+      ChildIterator it(*this);
+      bool bResult = it.atEnd(); // no children to test passes
+      for (; !it.atEnd(); ++it) {
+        if (testChild(it.getIndex())) {
           bResult = true;
           if ( bShortCircuit ) {
+            testDeferredChildren(it.getPos()+1);
             break;
           }
         }
       }
+      updateOrder();
       return bResult;
     }
+
+  protected:
+    void compileChildren(ConstraintPlan& plan) override {
+      compileJoined(plan, ConstraintPlan::JUMP_IF_TRUE, ConstraintPlan::OR);
+    }
   };
 
 }
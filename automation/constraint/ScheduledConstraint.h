@@ -4,6 +4,8 @@
 #include "Constraint.h"
 #include "BooleanConstraint.h"
 #include "NestedConstraint.h"
+#include "../LocalTime.h"
+#include "../TimerWheel.h"
 #include <ctime>
 #include <vector>
 
@@ -17,17 +19,47 @@ namespace automation {
   public:
     RTTI_GET_TYPE_IMPL(automation,Scheduled)
 
-    struct RangeVector : public vector<pair<uint16_t,uint16_t>> {
+    bool bRangesChanged = true;
+
+    // Ranges of one unit.  The cached result depends on them so they can only be changed through 
+    // assignment, push_back() or clear(), which flag the ranges as changed.
+    class RangeVector : private vector<pair<uint16_t,uint16_t>> {
+    public:
+      typedef pair<uint16_t,uint16_t> Range;
+      typedef vector<Range> Ranges;
+
       int *pMember;
-      RangeVector(int* pMember) : pMember(pMember) {
+      bool *pChanged;
+      RangeVector(int* pMember, bool* pChanged) : pMember(pMember), pChanged(pChanged) {
       }
 
-      RangeVector& operator=(const vector<pair<uint16_t,uint16_t>>& rhs) {
-        vector<pair<uint16_t,uint16_t>>::operator=(rhs);
+      RangeVector& operator=(const Ranges& rhs) {
+        Ranges::operator=(rhs);
+        *pChanged = true;
         return *this;
       }
 
-      bool check() {
+      RangeVector& operator=(const RangeVector& rhs) {
+        return *this = static_cast<const Ranges&>(rhs); // keep our own member and flag
+      }
+
+      void push_back(const Range& range) {
+        Ranges::push_back(range);
+        *pChanged = true;
+      }
+
+      void clear() {
+        Ranges::clear();
+        *pChanged = true;
+      }
+
+      Ranges::const_iterator begin() const { return Ranges::begin(); }
+      Ranges::const_iterator end() const { return Ranges::end(); }
+      const Range& operator[](size_t i) const { return Ranges::operator[](i); }
+      using Ranges::empty;
+      using Ranges::size;
+
+      bool check() const {
         int val = *pMember;
         for ( auto range : *this ) {
           if ( val >= range.first && val <= range.second )
@@ -39,35 +71,183 @@ namespace automation {
 
     struct tm checkTime;
 
-    RangeVector seconds = { &checkTime.tm_sec };
-    RangeVector minutes = { &checkTime.tm_min };
-    RangeVector hours = { &checkTime.tm_hour };
-    RangeVector weekDays = { &checkTime.tm_wday };
-    RangeVector monthDays = { &checkTime.tm_mday };
-    RangeVector months = { &checkTime.tm_mon };
-    RangeVector years = { &checkTime.tm_year };
+    RangeVector seconds = { &checkTime.tm_sec, &bRangesChanged };
+    RangeVector minutes = { &checkTime.tm_min, &bRangesChanged };
+    RangeVector hours = { &checkTime.tm_hour, &bRangesChanged };
+    RangeVector weekDays = { &checkTime.tm_wday, &bRangesChanged };
+    RangeVector monthDays = { &checkTime.tm_mday, &bRangesChanged };
+    RangeVector months = { &checkTime.tm_mon, &bRangesChanged };
+    RangeVector years = { &checkTime.tm_year, &bRangesChanged };
     vector<RangeVector*> rangeVectorList = { &years, &months, &monthDays, &weekDays, &hours, &minutes, &seconds };
 
     ScheduledConstraint(Constraint *pConstraint = &automation::PASS_CONSTRAINT) :
         NestedConstraint(pConstraint) {
     }
 
+    bool isInputChanged() override {
+      return isChildInputChanged() || !isScheduleCurrent();
+    }
+
+    bool isInputPolled() override {
+      return true; // clock changes are not reported
+    }
+
     bool outerCheckValue(bool bInnerCheckResult) override {
       return bInnerCheckResult ? checkRanges() : false;
     }
 
+    // The ranges only change result at a boundary so the result is cached until the next one
     bool checkRanges() {
       if ( !automation::isTimeValid() ) {
+        bRangesChanged = true;
         return false; // for arduino when no time hardware and time never set
       }
-      time_t now = std::time(nullptr);
-      checkTime = *localtime(&now);
+      if ( isScheduleCurrent() ) {
+        return bRangesPassed;
+      }
+      LocalTime& localTime = LocalTime::instance();
+      checkTime = localTime.getTm();
+      bRangesPassed = true;
       for( auto unitRanges : rangeVectorList) {
         if ( !unitRanges->check() ) {
-          return false;
+          bRangesPassed = false;
+          break;
+        }
+      }
+      updateNextBoundary(localTime.getTime());
+      return bRangesPassed;
+    }
+
+    bool isScheduleCurrent() {
+      if ( bRangesChanged || clockGeneration != LocalTime::instance().getClockGeneration() ) {
+        return false;
+      }
+      time_t now = LocalTime::instance().getTime();
+      return now >= checkedTime && (!bHaveNextBoundary || now < nextBoundaryTime);
+    }
+
+    virtual void printVerboseExtra(json::JsonStreamWriter& w) const override {
+      w.printlnBoolObj(F("rangesPassed"),bRangesPassed,",");
+      if ( bHaveNextBoundary ) {
+        time_t now = LocalTime::instance().getTime();
+        w.printlnNumberObj(F("secondsToNextBoundary"),(long)(nextBoundaryTime > now ? nextBoundaryTime - now : 0),",");
+      }
+    }
+
+  protected:
+    enum Unit : uint8_t { YEAR, MONTH, MONTH_DAY, WEEK_DAY, HOUR, MINUTE, SECOND }; // rangeVectorList order
+
+    bool bRangesPassed = false;
+    bool bHaveNextBoundary = false;
+    uint8_t clockGeneration = 0;
+    time_t checkedTime = 0, nextBoundaryTime = 0;
+
+    // Tests the constraint when the next boundary is reached instead of waiting for the next refresh
+    struct BoundaryTimer : public TimerWheel::Timer {
+      ScheduledConstraint& constraint;
+      BoundaryTimer(ScheduledConstraint& constraint) : constraint(constraint) {}
+
+      void expired() override {
+        LocalTime::instance().invalidate(); // the cached time may still be before the boundary
+        if ( !constraint.isScheduleCurrent() ) {
+          constraint.setDirty();
+          Constraints::requestEvaluation();
+        } else {
+          constraint.scheduleBoundaryTimer(); // woke early (seconds clock vs millis)
         }
       }
-      return true;
+    } boundaryTimer {*this};
+
+    // The result can only change where one unit enters or leaves a range: at a range begin, one past a
+    // range end, or when the unit wraps to its first value.  The earliest of these (cron style) is the next 
+    // boundary.  Testing again there is required even if another unit keeps the result the same.
+    void updateNextBoundary(time_t now) {
+      bRangesChanged = false;
+      clockGeneration = LocalTime::instance().getClockGeneration();
+      checkedTime = now;
+      bHaveNextBoundary = false;
+      for ( uint8_t unit = 0; unit < rangeVectorList.size(); unit++ ) {
+        const RangeVector& ranges = *rangeVectorList[unit];
+        if ( ranges.empty() ) {
+          continue;
+        }
+        considerBoundary(unit, unit == MONTH_DAY ? 1 : 0, now);
+        for ( auto range : ranges ) {
+          considerBoundary(unit, range.first, now);
+          considerBoundary(unit, range.second + 1, now);
+        }
+      }
+      scheduleBoundaryTimer();
+    }
+
+    void considerBoundary(uint8_t unit, int value, time_t now) {
+      time_t t = nextTimeWithValue(unit, value);
+      if ( t > now && (!bHaveNextBoundary || t < nextBoundaryTime) ) {
+        nextBoundaryTime = t;
+        bHaveNextBoundary = true;
+      }
+    }
+
+    // First time after checkTime where unit is value and finer units are at their first value (mktime 
+    // normalizes values past the end of a unit).  Returns 0 if there is none.
+    time_t nextTimeWithValue(uint8_t unit, int value) {
+      struct tm t = checkTime;
+      int current = *rangeVectorList[unit]->pMember;
+      bool bWrap = value <= current;
+      switch (unit) {
+        case YEAR:
+          if ( bWrap ) {
+            return 0;
+          }
+          t.tm_year = value;
+          t.tm_mon = 0;
+          t.tm_mday = 1;
+          break;
+        case MONTH:
+          t.tm_mon = value;
+          t.tm_year += bWrap;
+          t.tm_mday = 1;
+          break;
+        case MONTH_DAY:
+          t.tm_mday = value;
+          t.tm_mon += bWrap;
+          break;
+        case WEEK_DAY:
+          t.tm_mday += bWrap ? value - current + 7 : value - current;
+          break;
+        case HOUR:
+          t.tm_hour = value;
+          t.tm_mday += bWrap;
+          t.tm_min = t.tm_sec = 0;
+          break;
+        case MINUTE:
+          t.tm_min = value;
+          t.tm_hour += bWrap;
+          t.tm_sec = 0;
+          break;
+        case SECOND:
+          t.tm_sec = value;
+          t.tm_min += bWrap;
+          break;
+      }
+      if ( unit < HOUR ) {
+        t.tm_hour = t.tm_min = t.tm_sec = 0;
+      }
+      t.tm_isdst = -1;
+      return mktime(&t);
+    }
+
+    void scheduleBoundaryTimer() {
+      if ( !bHaveNextBoundary ) {
+        TimerWheel::instance().cancel(boundaryTimer);
+        return;
+      }
+      time_t now = LocalTime::instance().getTime();
+      unsigned long delaySec = nextBoundaryTime > now ? nextBoundaryTime - now : 0;
+      if ( delaySec > 24*3600UL ) {
+        delaySec = 24*3600UL; // keep within millis range... the timer reschedules itself
+      }
+      TimerWheel::instance().scheduleIn(boundaryTimer, delaySec*SECONDS);
     }
   };
 }
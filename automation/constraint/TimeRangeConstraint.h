@@ -3,6 +3,7 @@
 
 #include "Constraint.h"
 #include "BooleanConstraint.h"
+#include "../LocalTime.h"
 #include <ctime>
 #include <vector>
 #include <sstream>
@@ -18,6 +19,8 @@ namespace automation {
     
     struct Time {
       int hour, minute, second;
+
+      uint32_t toSecondsOfDay() const { return LocalTime::toSecondsOfDay(hour, minute, second); }
     } beginTime, endTime;
 
     static string timeAsString(const Time& t) {
@@ -34,26 +37,20 @@ namespace automation {
 
     TimeRangeConstraint(Time beginTime, Time endTime) :
         beginTime(beginTime),
-        endTime(endTime) {
+        endTime(endTime),
+        beginSec(beginTime.toSecondsOfDay()),
+        endSec(endTime.toSecondsOfDay()) {
     }
 
     bool checkValue() override {
       if ( !automation::isTimeValid() ) {
         return false; // for arduino when no time hardware and time never set
       }
-      time_t now = std::time(nullptr);
-      struct tm checkTime = *localtime(&now);
-      struct tm beginTm = checkTime, endTm = checkTime;
-      beginTm.tm_hour = beginTime.hour;
-      beginTm.tm_min = beginTime.minute;
-      beginTm.tm_sec = beginTime.second;
-      endTm.tm_hour = endTime.hour;
-      endTm.tm_min = endTime.minute;
-      endTm.tm_sec = endTime.second;
-      now = mktime(&checkTime);
-      time_t beginTimeT = mktime(&beginTm);
-      time_t endTimeT = mktime(&endTm);
-      return now >= beginTimeT && now <= endTimeT;
+      uint32_t nowSec = LocalTime::instance().getSecondsOfDay();
+      if ( beginSec <= endSec ) {
+        return nowSec >= beginSec && nowSec <= endSec;
+      }
+      return nowSec >= beginSec || nowSec <= endSec; // range wraps past midnight
     }
 
     string getTitle() const override {
@@ -70,6 +67,9 @@ namespace automation {
       w.printlnStringObj(F("beginTime"),timeAsString(beginTime),",");
       w.printlnStringObj(F("endTime"),timeAsString(endTime),",");
     }
+
+  protected:
+    uint32_t beginSec, endSec; // seconds of day
   };
 
 }
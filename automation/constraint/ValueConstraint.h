@@ -2,6 +2,8 @@
 #define SOLAR_IFTTT_VALUECONSTRAINT_H
 
 #include "Constraint.h"
+#include "../sensor/Sensor.h"
+#include "../sensor/LinearTrend.h"
 #include "../text.h"
 
 #include <string>
@@ -18,17 +20,27 @@ namespace automation {
   };
   
 
+  // Tested again when the sensor publishes an epoch with a new value.  Sensors that are not cacheable or 
+  // not sampled by Sensors (no epochs) are compared on every pass instead.  ValueSourceT must be a Sensor 
+  // (declared as Sensor& like AtLeast<float,Sensor&>) since the constructor registers for its epochs.
   template<typename ValueT, typename ValueSourceT>
-  class ValueConstraint : public Constraint {
+  class ValueConstraint : public Constraint, public SensorEpochListener {
 
   public:
     ValueConstraint(ValueSourceT& valueSource) : valueSource(valueSource) {
+      valueSource.addEpochListener(this);
+    }
+
+    ~ValueConstraint() {
+      this->valueSource.removeEpochListener(this);
     }
 
     ValueValidator<ValueT>* pValueValidator{ nullptr };
 
     bool checkValue() override {
       const ValueT &value = getValue();
+      checkedValue = value;
+      bHaveCheckedValue = true;
       if ( pValueValidator && !pValueValidator->isValid(value) ) {
         return pValueValidator->getPassOnInvalid();
       } else {
@@ -40,6 +52,22 @@ namespace automation {
       return valueSource.getValue();
     }
 
+    // Value source is the dependency... unchanged value means unchanged result (NaN always retests)
+    void epochPublished(const Sensor&, float value) override {
+      bEpochPublished = true;
+      if ( !bHaveCheckedValue || !(value == checkedValue) ) {
+        setDirty();
+      }
+    }
+
+    bool isInputChanged() override {
+      return isInputPolled() && (!bHaveCheckedValue || !(getValue() == checkedValue));
+    }
+
+    bool isInputPolled() override {
+      return !bEpochPublished || !valueSource.isCacheable();
+    }
+
     virtual bool checkValue(const ValueT &val) = 0;
 
     void printValueSourceObj(json::JsonStreamWriter& w,const char* pszKey, const char* pszSeparator = "") const {
@@ -66,6 +94,9 @@ namespace automation {
 
   protected:
     ValueSourceT& valueSource;
+    ValueT checkedValue;
+    bool bHaveCheckedValue = false;
+    bool bEpochPublished = false;
 
   };
 
@@ -131,6 +162,9 @@ namespace automation {
           strResultValue = text::asString(maxVal);
           rtn = SetCode::OK;
         }
+        if ( rtn == SetCode::OK ) {
+          this->setDirty();
+        }
         if (pRespStream && rtn == SetCode::OK ) {
           (*pRespStream) << "'" << getTitle() << "' " << pszKey << "=" << strResultValue;
         }
@@ -184,6 +218,21 @@ namespace automation {
       return rtn;
     }
 
+    bool checkValue() override {
+      checkedThreshold = pThreshold->getValue();
+      return ValueConstraint<ValueT,ValueSourceT>::checkValue();
+    }
+
+    // A threshold that is not our own constant can change at any time
+    bool isInputChanged() override {
+      return ValueConstraint<ValueT,ValueSourceT>::isInputChanged() || 
+          (!bDeleteThreshold && !(pThreshold->getValue() == checkedThreshold));
+    }
+
+    bool isInputPolled() override {
+      return ValueConstraint<ValueT,ValueSourceT>::isInputPolled() || !bDeleteThreshold;
+    }
+
     virtual ~ThresholdValueConstraint() {
       if ( bDeleteThreshold ) {        
         delete pThreshold;
@@ -196,6 +245,7 @@ namespace automation {
         } 
         bDeleteThreshold = true;
         pThreshold = new ConstantValueHolder<ValueT>(threshold);
+        this->setDirty();
     }
 
     SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream = nullptr) override {
@@ -215,6 +265,8 @@ namespace automation {
     }
 
     protected:
+    ValueT checkedThreshold;
+
     ThresholdValueConstraint(ValueHolder<ValueT>* pThreshold, ValueSourceT &valueSource, bool bDeleteThreshold = true )
         : ValueConstraint<ValueT,ValueSourceT>(valueSource)
         , pThreshold(pThreshold)
@@ -278,5 +330,113 @@ namespace automation {
     }
   };
 
+  // Passes when the trend of the value source over the window rises at least rate per minute (or falls at 
+  // least as fast as a negative rate).  The trend is a least squares line updated as samples come and go.
+  // Samples are the values of each epoch the sensor publishes (it must be in the sketch's Sensors) so the 
+  // trend keeps up even while a short circuit or compiled plan skips this constraint.
+  template<typename ValueT, typename ValueSourceT>
+  class SlopeConstraint : public ValueConstraint<ValueT,ValueSourceT> {
+  public:
+    RTTI_GET_TYPE_IMPL(automation,Slope)
+
+    static const uint8_t SAMPLE_CAPACITY = 12;
+
+    float ratePerMinute;
+
+    SlopeConstraint(float ratePerMinute, ValueSourceT &valueSource, unsigned long windowMs = 5*MINUTES)
+        : ValueConstraint<ValueT,ValueSourceT>(valueSource)
+        , ratePerMinute(ratePerMinute)
+        , trend(SAMPLE_CAPACITY, windowMs) {
+    }
+
+    void epochPublished(const Sensor&, float value) override {
+      trend.add(value, millisecs());
+    }
+
+    bool isInputChanged() override {
+      return true; // slope changes as time passes even if the value does not
+    }
+
+    bool isInputPolled() override {
+      return true;
+    }
+
+    bool checkValue(const ValueT &) override {
+      trend.expire(millisecs());
+      float slope = trend.getSlopePerMinute();
+      if ( isnan(slope) ) {
+        return false; // not enough samples yet
+      }
+      float rate = ratePerMinute;
+      float direction = rate < 0 ? -1 : 1;
+      if (this->deferredTimeMs) {
+        if (this->isPassed()) {
+          rate -= direction * this->failMargin;
+        } else {
+          rate += direction * this->passMargin;
+        }
+      }
+      return direction > 0 ? slope >= rate : slope <= rate;
+    }
+
+    float getSlopePerMinute() const { return trend.getSlopePerMinute(); }
+
+    const LinearTrend& getTrend() const { return trend; }
+
+    virtual void printVerboseExtra(json::JsonStreamWriter& w) const override {
+      ValueConstraint<ValueT,ValueSourceT>::printlnValueSourceObj(w,"valueSource",",");
+      w.printlnNumberObj(F("rate"),ratePerMinute,",");
+      w.printlnNumberObj(F("windowSec"),trend.getWindowMs()/1000,",");
+      w.printlnNumberObj(F("sampleCnt"),(int)trend.getCount(),",");
+      float slope = trend.getSlopePerMinute();
+      if ( isnan(slope) ) {
+        w.printlnStringObj(F("slope"),slope,",");
+      } else {
+        w.printlnNumberObj(F("slope"),slope,",");
+      }
+    }
+
+    string getTitle() const override {
+      string rtn(this->valueSource.name);
+      rtn += " Slope(";
+      rtn += text::asString(ratePerMinute);
+      rtn += "/min)";
+      return rtn;
+    }
+
+    SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream = nullptr) override {
+      SetCode rtn = ValueConstraint<ValueT,ValueSourceT>::setAttribute(pszKey,pszVal,pRespStream);
+      string strResultValue;
+      if ( rtn == SetCode::Ignored ) {
+        if ( !strcasecmp_P(pszKey,PSTR("rate")) ) {
+          ratePerMinute = atof(pszVal);
+          strResultValue = text::asString(ratePerMinute);
+          rtn = SetCode::OK;
+        } else if ( !strcasecmp_P(pszKey,PSTR("window")) ) {
+          unsigned long windowSec = atol(pszVal);
+          if ( windowSec == 0 ) {
+            if (pRespStream) {
+              (*pRespStream) << RVSTR("window must be at least 1 second");
+            }
+            return SetCode::Error;
+          }
+          trend.setWindowMs(windowSec*1000);
+          strResultValue = text::asString(windowSec);
+          rtn = SetCode::OK;
+        }
+        if ( rtn == SetCode::OK ) {
+          this->setDirty();
+        }
+        if (pRespStream && rtn == SetCode::OK ) {
+          (*pRespStream) << "'" << getTitle() << "' " << pszKey << "=" << strResultValue;
+        }
+      }
+      return rtn;
+    }
+
+  protected:
+    LinearTrend trend;
+  };
+
 }
 #endif //SOLAR_IFTTT_VALUECONSTRAINT_H
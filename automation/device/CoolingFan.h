@@ -4,6 +4,7 @@
 #include "../sensor/Sensor.h"
 #include "PowerSwitch.h"
 #include "../constraint/ValueConstraint.h"
+#include "../sensor/LinearTrend.h"
 
 using namespace std;
 
@@ -20,21 +21,110 @@ namespace automation {
     bool getPassOnInvalid() const override { return true; } // want fan on if don't know temperature due to error
   };
 
+  // AtLeast that can also pass early (predictive mode) when the temperature trend is projected to reach the 
+  // on temp within the horizon.  Turning off is unchanged (off temp and min duration).
+  struct FanTempConstraint : public AtLeast<float,Sensor&> {
+    CoolingFan& fan;
+    bool bPredictedPass = false; // last check passed only because of the projection
+
+    FanTempConstraint(CoolingFan& fan, float onTemp, Sensor& tempSensor) :
+        AtLeast<float,Sensor&>(onTemp,tempSensor),
+        fan(fan) {
+    }
+
+    bool isInputChanged() override;
+    bool isInputPolled() override;
+    bool checkValue(const float &value) override;
+  };
+
   public:
 
+    static const uint8_t TREND_CAPACITY = 8;
+
+    // How each start of the fan was triggered.  For predicted starts, lead time is how long before the
+    // temperature actually reached the on temp the fan was started.
+    struct ActivationStats {
+      uint16_t reactiveCnt = 0;
+      uint16_t predictedCnt = 0;
+      uint16_t predictedMissCnt = 0; // predicted starts that turned off without reaching the on temp
+      uint16_t leadCnt = 0;
+      unsigned long totalLeadMs = 0;
+      unsigned long lastLeadMs = 0;
+      unsigned long startMs = 0;
+      bool bLastPredicted = false;
+      bool bAwaitingOnTemp = false; // predicted start and on temp not reached yet
+    };
+
     Sensor& tempSensor;
-    AtLeast<float,Sensor&> minTemp; // any temp greater than this min will PASS (turn fan on)
+    FanTempConstraint minTemp; // any temp greater than this min will PASS (turn fan on)
     FanTempValidator fanTempValidator;
+    unsigned long predictHorizonMs = 5*MINUTES;
 
     CoolingFan(const string &name, Sensor& tempSensor, float onTemp, float offTemp, unsigned int minDurationMs=0) :
         PowerSwitch(name),
         tempSensor(tempSensor),
-        minTemp(onTemp,tempSensor) {
+        minTemp(*this,onTemp,tempSensor) {
       minTemp.setFailMargin(onTemp-offTemp).setFailDelayMs(minDurationMs);
       minTemp.pValueValidator = &fanTempValidator;
       setConstraint(&minTemp);
     }
 
+    virtual ~CoolingFan() {
+      delete pTrend;
+    }
+
+    // Trend samples are only kept (allocated) while predictive mode is on
+    void setPredictive(bool bPredictive, unsigned long trendWindowMs = 10*MINUTES) {
+      delete pTrend;
+      pTrend = bPredictive ? new LinearTrend(TREND_CAPACITY, trendWindowMs) : nullptr;
+      minTemp.setDirty();
+    }
+
+    bool isPredictive() const { return pTrend != nullptr; }
+
+    float getOnTemp() const {
+      return minTemp.pThreshold->getValue() + minTemp.getPassMargin();
+    }
+
+    // Temperature the trend projects at the end of the horizon (NaN if not predictive or not enough samples)
+    float getProjectedTemp(unsigned long nowMs = millisecs()) const {
+      return pTrend ? pTrend->getValueAt(nowMs + predictHorizonMs) : NAN;
+    }
+
+    const ActivationStats& getActivationStats() const { return activationStats; }
+
+    void resultChanged(Constraint* pConstraint,bool bNew,unsigned long lastDurationMs) const override {
+      PowerSwitch::resultChanged(pConstraint,bNew,lastDurationMs);
+      if ( pConstraint != &minTemp ) {
+        return;
+      }
+      ActivationStats& stats = activationStats;
+      if ( bNew ) {
+        stats.bLastPredicted = minTemp.bPredictedPass;
+        stats.startMs = millisecs();
+        stats.bAwaitingOnTemp = stats.bLastPredicted;
+        if ( stats.bLastPredicted ) {
+          stats.predictedCnt++;
+        } else {
+          stats.reactiveCnt++;
+        }
+      } else if ( stats.bAwaitingOnTemp ) {
+        stats.bAwaitingOnTemp = false;
+        stats.predictedMissCnt++;
+      }
+    }
+
+    // Called with each valid temperature checked while predictive
+    void onTempChecked(float temp, unsigned long nowMs) {
+      ActivationStats& stats = activationStats;
+      if ( stats.bAwaitingOnTemp && temp >= getOnTemp() ) {
+        stats.bAwaitingOnTemp = false;
+        stats.lastLeadMs = nowMs - stats.startMs;
+        stats.totalLeadMs += stats.lastLeadMs;
+        stats.leadCnt++;
+      }
+    }
+
     virtual SetCode setAttribute(const char* pszKey, const char* pszVal, ostream* pRespStream) override {
       string strResultValue;
       SetCode rtn = PowerSwitch::setAttribute(pszKey,pszVal,pRespStream);
@@ -57,6 +147,28 @@ namespace automation {
           minTemp.setFailDelayMs(durationMs); // fan will run at least this duration
           strResultValue = text::asString(minTemp.getFailDelayMs());
           rtn = SetCode::OK;
+        } else if ( !strcasecmp_P(pszKey,PSTR("predictive")) ) {
+          setPredictive(text::parseBool(pszVal), pTrend ? pTrend->getWindowMs() : 10*MINUTES);
+          strResultValue = text::boolAsString(isPredictive());
+          rtn = SetCode::OK;
+        } else if ( !strcasecmp_P(pszKey,PSTR("horizonSec")) ) {
+          predictHorizonMs = atol(pszVal)*1000;
+          minTemp.setDirty();
+          strResultValue = text::asString(predictHorizonMs/1000);
+          rtn = SetCode::OK;
+        } else if ( !strcasecmp_P(pszKey,PSTR("trendWindowSec")) ) {
+          unsigned long windowSec = atol(pszVal);
+          if ( pTrend && windowSec > 0 ) {
+            pTrend->setWindowMs(windowSec*1000);
+            minTemp.setDirty();
+            strResultValue = text::asString(windowSec);
+            rtn = SetCode::OK;
+          } else {
+            if (pRespStream) {
+              (*pRespStream) << RVSTR("trendWindowSec requires predictive mode and a value over 0");
+            }
+            rtn = SetCode::Error;
+          }
         }
         if (pRespStream && rtn == SetCode::OK ) {
           (*pRespStream) << pszKey << "=" << strResultValue;
@@ -79,9 +191,60 @@ namespace automation {
       w.printlnNumberObj(F("offTemp"),getOffTemp(),",");
       w.printlnNumberObj(F("minDurationMs"),minTemp.getFailDelayMs(),",");
       w.printlnNumberObj(F("currentTemp"),tempSensor.getValue(),",");
+      w.printlnBoolObj(F("predictive"),isPredictive(),",");
+      if ( pTrend ) {
+        w.printlnNumberObj(F("horizonSec"),predictHorizonMs/1000,",");
+        w.printlnNumberObj(F("trendWindowSec"),pTrend->getWindowMs()/1000,",");
+        float projectedTemp = getProjectedTemp();
+        if ( isnan(projectedTemp) ) {
+          w.printlnStringObj(F("projectedTemp"),projectedTemp,",");
+        } else {
+          w.printlnNumberObj(F("projectedTemp"),projectedTemp,",");
+        }
+      }
+      const ActivationStats& stats = activationStats;
+      w.printKey(F("activations"));
+      w.noPrefixPrintln("{");
+      w.increaseDepth();
+      w.printlnNumberObj(F("reactiveCnt"),stats.reactiveCnt,",");
+      w.printlnNumberObj(F("predictedCnt"),stats.predictedCnt,",");
+      w.printlnNumberObj(F("predictedMissCnt"),stats.predictedMissCnt,",");
+      w.printlnNumberObj(F("avgLeadSec"),stats.leadCnt ? stats.totalLeadMs/stats.leadCnt/1000 : 0,",");
+      w.printlnNumberObj(F("lastLeadSec"),stats.lastLeadMs/1000,",");
+      w.printlnStringObj(F("lastStart"),stats.startMs ? (stats.bLastPredicted ? F("predicted") : F("reactive")) : F("none"));
+      w.decreaseDepth();
+      w.println("},");
     }
 
+  protected:
+    LinearTrend* pTrend = nullptr;
+    mutable ActivationStats activationStats; // updated from const resultChanged()
+
   };
 
+  inline bool CoolingFan::FanTempConstraint::isInputChanged() {
+    return fan.isPredictive() || AtLeast<float,Sensor&>::isInputChanged(); // projection moves with time
+  }
+
+  inline bool CoolingFan::FanTempConstraint::isInputPolled() {
+    return fan.isPredictive() || AtLeast<float,Sensor&>::isInputPolled();
+  }
+
+  inline bool CoolingFan::FanTempConstraint::checkValue(const float &value) {
+    bool bPassed = AtLeast<float,Sensor&>::checkValue(value);
+    bPredictedPass = false;
+    if ( fan.pTrend ) {
+      unsigned long nowMs = millisecs();
+      fan.pTrend->add(value, nowMs);
+      fan.pTrend->expire(nowMs);
+      fan.onTempChecked(value, nowMs);
+      if ( !bPassed && fan.pTrend->getSlopePerMinute() > 0 && fan.getProjectedTemp(nowMs) >= fan.getOnTemp() ) {
+        bPredictedPass = true;
+        bPassed = true;
+      }
+    }
+    return bPassed;
+  }
+
 }
 #endif //ARDUINO_SOLAR_SKETCH_COOLINGFAN_H
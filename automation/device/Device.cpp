@@ -6,7 +6,7 @@
 namespace automation {
 
 void Device::applyConstraint(bool bIgnoreSameState, Constraint *pConstraint) {
-  
+  PROFILE_SCOPE(applyConstraintProfile)
   if ( !pConstraint ) {
     pConstraint = this->pConstraint;
   }
@@ -15,7 +15,7 @@ void Device::applyConstraint(bool bIgnoreSameState, Constraint *pConstraint) {
         return;
     }
     bool bLastPassed = pConstraint->isPassed();
-    bool bPassed = pConstraint->test();
+    bool bPassed = pConstraintPlan && pConstraint == this->pConstraint ? pConstraintPlan->run() : pConstraint->test();
     //if (!bIgnoreSameState || bPassed != bLastPassed ) {
     //  constraintResultChanged(bPassed);
     //}
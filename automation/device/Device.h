@@ -3,7 +3,9 @@
 
 #include "../json/JsonStreamWriter.h"
 #include "../constraint/Constraint.h"
+#include "../constraint/ConstraintPlan.h"
 #include "../AttributeContainer.h"
+#include "../Profiler.h"
 
 #include <vector>
 #include <string>
@@ -30,11 +32,13 @@ namespace automation {
       if ( pConstraint ) {
         pConstraint->listeners.remove(this);
       }
+      delete pConstraintPlan;
     }
 
     RTTI_GET_TYPE_DECL;
     
     virtual void applyConstraint(bool bIgnoreSameState = true, Constraint *pConstraint = nullptr);
+    PROFILE_COUNTER(applyConstraintProfile)
 
     //virtual void constraintResultChanged(bool bConstraintResult) = 0;
 
@@ -50,6 +54,21 @@ namespace automation {
       }
       this->pConstraint = pConstraint;
       this->pConstraint->listeners.add(this);
+      delete pConstraintPlan;
+      pConstraintPlan = nullptr;
+    }
+
+    // Optional... applyConstraint() runs the compiled plan instead of recursive test() calls.  Call from 
+    // setup() after the constraint tree is built (the plan is not updated if children change).  Not used
+    // by the sketch since plans measure about as fast as test() (see ConstraintPlan).
+    bool compileConstraint() {
+      if ( !pConstraint ) {
+        return false;
+      }
+      if ( !pConstraintPlan ) {
+        pConstraintPlan = new ConstraintPlan();
+      }
+      return pConstraintPlan->compile(pConstraint);
     }
 
     bool isPassed() {
@@ -69,6 +88,7 @@ namespace automation {
 
   private:
     Constraint *pConstraint = nullptr;
+    ConstraintPlan *pConstraintPlan = nullptr;
 
   };
 
@@ -0,0 +1,111 @@
+#ifndef __AUTOMATION_JSON_BINARY_FRAME_WRITER__
+#define __AUTOMATION_JSON_BINARY_FRAME_WRITER__
+
+#include "JsonStreamWriter.h"
+#include "../AttributeContainer.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace automation {
+namespace json {
+
+/**
+ *  Compact telemetry alternative to JSON for polling values (JsonFormat::BINARY or BINARY_FLOAT).
+ *
+ *  frame:  SYNC(0xA5) FRAME_VERSION(1) length(uint16) records... fletcher16(uint16)
+ *  record: id(NumericIdentifierValue) type(uint8) value(4 bytes)
+ *
+ *  Multi-byte fields are little endian.  length counts record bytes and the checksum covers FRAME_VERSION
+ *  through the last record.  Fixed point values are int32 thousandths and fall back to FLOAT32 when
+ *  out of range.  Byte count and checksum reported in #END include the whole frame.
+ **/
+class BinaryFrameWriter : public JsonStreamWriter
+{
+  public:
+
+  static const uint8_t SYNC = 0xA5;
+  static const uint8_t FRAME_VERSION = 1;
+  static const uint8_t RECORD_SIZE = sizeof(NumericIdentifierValue) + 1 + sizeof(uint32_t);
+
+  enum ValueType : uint8_t { NAN_VALUE = 0, FIXED_MILLI = 1, FLOAT32 = 2 };
+
+  BinaryFrameWriter(OutputStreamPrinter& impl, bool bFloat = false) :
+    JsonStreamWriter(impl),
+    bFloat(bFloat)
+  {
+  }
+
+  BinaryFrameWriter& beginFrame(uint16_t recordCnt)
+  {
+    sum1 = sum2 = 0;
+    staging.sputc(SYNC);
+    writeByte(FRAME_VERSION);
+    writeUint16(recordCnt*RECORD_SIZE);
+    return *this;
+  }
+
+  BinaryFrameWriter& record(NumericIdentifierValue id, float value)
+  {
+    for (uint8_t i = 0; i < sizeof(id); i++) {
+      writeByte((id >> (8*i)) & 0xFF);
+    }
+    if ( isnan(value) ) {
+      writeByte(NAN_VALUE);
+      writeUint32(0);
+    } else if ( !bFloat && fabs(value) < 2000000.0f ) {
+      writeByte(FIXED_MILLI);
+      writeUint32((uint32_t) (int32_t) lround(value*1000.0));
+    } else {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      writeByte(FLOAT32);
+      writeUint32(bits);
+    }
+    return *this;
+  }
+
+  BinaryFrameWriter& endFrame()
+  {
+    uint16_t fletcher = (sum2 << 8) | sum1;
+    writeUint16(fletcher);
+    return *this;
+  }
+
+  // One record per item, items need id and getValue()
+  template<typename TArray>
+  BinaryFrameWriter& printFrame(const TArray& arr)
+  {
+    beginFrame(arr.size());
+    for (auto pItem : arr) {
+      record(pItem->id, pItem->getValue());
+    }
+    return endFrame();
+  }
+
+  protected:
+  bool bFloat;
+  uint8_t sum1 = 0, sum2 = 0;
+
+  void writeByte(uint8_t b)
+  {
+    sum1 = (sum1 + b) % 255;
+    sum2 = (sum2 + sum1) % 255;
+    staging.sputc(b);
+  }
+
+  void writeUint16(uint16_t v)
+  {
+    writeByte(v & 0xFF);
+    writeByte(v >> 8);
+  }
+
+  void writeUint32(uint32_t v)
+  {
+    writeUint16(v & 0xFFFF);
+    writeUint16(v >> 16);
+  }
+};
+
+}}
+#endif
@@ -3,7 +3,6 @@
 
 // Do not refactor with a JSON library.  This class allows Arduino Serial port JSON to share same format as external processes.
 
-#include "SerialByteCounter.h"
 #include "OutputStreamPrinter.h"
 #include "json.h"
 
@@ -17,27 +16,108 @@ namespace json {
 class JsonStreamWriter
 {
   protected:
-  SerialByteCounter byteCounter;
-  unsigned long byteCnt;
-  unsigned long checksum;
 
-  OutputStreamPrinter& impl;
-  
-  template<typename TPrintable>
-  void updateState(TPrintable printable) 
+  // Each token is formatted once into a small buffer.  Byte count and checksum are updated
+  // from the same bytes that are handed to the output stream when the buffer is flushed.
+  // RAM: a writer (often a temporary on the stack) holds only this buffer, the streambuf
+  // pointers and the counters.  Numbers are formatted by one ostream shared by all writers
+  // and pointed at the writer's buffer for each token, so no ios state is kept per writer.
+  // Longer tokens than BUFFER_SIZE just flush part way through.
+  class StagingBuffer : public std::streambuf
+  {
+    public:
+    static const int BUFFER_SIZE = 16;
+    OutputStreamPrinter& impl;
+    unsigned long byteCnt;
+    unsigned long checksum;
+
+    StagingBuffer(OutputStreamPrinter& impl) : impl(impl), byteCnt(0), checksum(0)
+    {
+      setp(buf, buf+BUFFER_SIZE);
+    }
+
+    void flush()
+    {
+      int n = pptr()-pbase();
+      if ( n == 0 ) {
+        return;
+      }
+      for (int i = 0; i < n; i++) {
+        checksum += (uint8_t) buf[i];
+      }
+      byteCnt += n;
+      if ( impl.pOs ) {
+        impl.pOs->rdbuf()->sputn(buf,n);
+      }
+      setp(buf, buf+BUFFER_SIZE);
+    }
+
+    void put(const char* psz)
+    {
+      while ( *psz ) {
+        if ( pptr() == epptr() ) {
+          flush();
+        }
+        *pptr() = *psz++;
+        pbump(1);
+      }
+    }
+
+    protected:
+    char buf[BUFFER_SIZE];
+
+    int overflow(int c) override
+    {
+      flush();
+      if ( c != EOF ) {
+        *pptr() = (char) c;
+        pbump(1);
+      }
+      return c;
+    }
+
+    int sync() override
+    {
+      flush();
+      return 0;
+    }
+  };
+
+  StagingBuffer staging;
+
+  static std::ostream& formatter()
   {
-    byteCounter.checksum = 0;
-    byteCnt += byteCounter.print(printable);
-    checksum += byteCounter.checksum;
+    static std::ostream os(nullptr);
+    return os;
   }
 
-  // All JsonStreamWriter prints should end up here.  
+  OutputStreamPrinter& impl;
+
+  // All JsonStreamWriter prints should end up here.
   template<typename TPrintable>
   void statefulPrint(TPrintable printable) { 
-    updateState(printable);
-    impl.print(printable);
+    std::ostream& os = formatter();
+    os.rdbuf(&staging);
+    os << printable;
+  }
+
+  void statefulPrint(const char* psz) { 
+    staging.put(psz);
   }
 
+  void statefulPrint(const std::string& str) { 
+    staging.put(str.c_str());
+  }
+
+#ifdef ARDUINO_APP
+  void statefulPrint(const __FlashStringHelper* pFlash) { 
+    const char* p = (const char*) pFlash;
+    for (char c = pgm_read_byte(p); c; c = pgm_read_byte(++p)) {
+      staging.sputc(c);
+    }
+  }
+#endif
+
   void statefulPrintln() { 
     statefulPrint("\n");
   }
@@ -50,20 +130,29 @@ class JsonStreamWriter
 
   public:
 
-  void clearByteCount() { byteCnt = 0; }
-  unsigned long getByteCount() { return byteCnt; }
-  void clearChecksum() { checksum = 0; }
-  unsigned long getChecksum() { return checksum; }
+  // Send staged bytes.  Called before anything bypasses the writer or reads the byte count.
+  void flush() { staging.flush(); }
+
+  void clearByteCount() { flush(); staging.byteCnt = 0; }
+  unsigned long getByteCount() { flush(); return staging.byteCnt; }
+  void clearChecksum() { flush(); staging.checksum = 0; }
+  unsigned long getChecksum() { flush(); return staging.checksum; }
 
   int depth;
   long beginStringObjByteCnt;
 
   JsonStreamWriter(OutputStreamPrinter& impl, int depth = 0) :
+    staging(impl),
     impl(impl),
     depth(depth)
   {
   }
 
+  ~JsonStreamWriter()
+  {
+    flush();
+  }
+
   JsonStreamWriter& printPrefix() { 
     if ( json::isPretty() ) {
       for (int i = 0; i < depth; i++) {
@@ -152,7 +241,7 @@ class JsonStreamWriter
   {     
     printKey(k);
     statefulPrint("\""); 
-    beginStringObjByteCnt = byteCnt;
+    beginStringObjByteCnt = getByteCount();
     return *this;
   }
 
@@ -209,7 +298,7 @@ class JsonStreamWriter
       // not currently writing a string value;
       return -1;
     }
-    return byteCnt - beginStringObjByteCnt;
+    return getByteCount() - beginStringObjByteCnt;
   }
 
   template<typename TKey, typename TVal>
@@ -262,25 +351,25 @@ class JsonStreamWriter
     return *this;
   }
 
-  template<typename TIterator>
-  JsonStreamWriter& printIterator(TIterator itr, TIterator endItr, 
-      const char* suffix = "", bool bVerbose = false ) {
+  // printIterator() in parts for listings that are written one item per call (CommandProcessor::step())
+  JsonStreamWriter& beginIterator() {
     noPrefixPrint("[");
     increaseDepth();
+    return *this;
+  }
 
-    bool bFirst = true;
-    while( itr != endItr )
-    {
-      if ( bFirst ) {
-        bFirst = false;
-        noPrefixPrintln();
-      } else {
-        noPrefixPrintln(",");
-      }
-      (*itr)->print(*this,bVerbose);
-      automation::threadKeepAliveReset();
-      itr++;
-    };
+  template<typename TItem>
+  JsonStreamWriter& printIteratorItem(TItem pItem, bool bFirst, bool bVerbose = false) {
+    if ( bFirst ) {
+      noPrefixPrintln();
+    } else {
+      noPrefixPrintln(",");
+    }
+    pItem->print(*this,bVerbose);
+    return *this;
+  }
+
+  JsonStreamWriter& endIterator(const char* suffix = "") {
     noPrefixPrintln();
     decreaseDepth();
     print("]");
@@ -288,6 +377,19 @@ class JsonStreamWriter
     return *this;
   }
 
+  template<typename TIterator>
+  JsonStreamWriter& printIterator(TIterator itr, TIterator endItr, 
+      const char* suffix = "", bool bVerbose = false ) {
+    beginIterator();
+    for( bool bFirst = true; itr != endItr; bFirst = false )
+    {
+      printIteratorItem(*itr,bFirst,bVerbose);
+      automation::threadKeepAliveReset();
+      itr++;
+    }
+    return endIterator(suffix);
+  }
+
   template<typename TKey, typename TIterator>
   JsonStreamWriter& printIteratorObj(TKey k, TIterator itr, TIterator endItr, 
       const char* suffix = "", bool bVerbose = false ) {
@@ -326,6 +428,7 @@ class JsonStreamWriter
   template<typename TPrintable>
   JsonStreamWriter& implPrint(TPrintable printable)
   { 
+    flush();
     impl.print(printable); 
     return *this; 
   } 
@@ -333,6 +436,7 @@ class JsonStreamWriter
   template<typename TPrintable>
   JsonStreamWriter& implPrintln(TPrintable printable)
   { 
+    flush();
     impl.println(printable); 
     return *this; 
   }
@@ -8,7 +8,8 @@ namespace automation
 namespace json
 {
 
-enum class JsonFormat { INVALID = -1, COMPACT, PRETTY };
+// BINARY formats send compact JSON except for telemetry polls (see BinaryFrameWriter)
+enum class JsonFormat { INVALID = -1, COMPACT, PRETTY, BINARY, BINARY_FLOAT };
 
 static JsonFormat jsonFormat = JsonFormat::PRETTY;
 
@@ -22,6 +23,14 @@ static JsonFormat parseFormat(const char *pszFormat)
   {
     return JsonFormat::PRETTY;
   }
+  else if (!strcasecmp_P(pszFormat, PSTR("BINARY")))
+  {
+    return JsonFormat::BINARY;
+  }
+  else if (!strcasecmp_P(pszFormat, PSTR("BINARY_FLOAT")))
+  {
+    return JsonFormat::BINARY_FLOAT;
+  }
   else
   {
     return JsonFormat::INVALID;
@@ -38,6 +47,14 @@ static string formatAsString(JsonFormat fmt)
   {
     return RVSTR("PRETTY");
   }
+  else if (fmt == JsonFormat::BINARY)
+  {
+    return RVSTR("BINARY");
+  }
+  else if (fmt == JsonFormat::BINARY_FLOAT)
+  {
+    return RVSTR("BINARY_FLOAT");
+  }
   else
   {
     string msg(RVSTR("INVALID:"));
@@ -48,6 +65,8 @@ static string formatAsString(JsonFormat fmt)
 
 static bool isPretty() { return jsonFormat == JsonFormat::PRETTY; }
 
+static bool isBinary() { return jsonFormat == JsonFormat::BINARY || jsonFormat == JsonFormat::BINARY_FLOAT; }
+
 } // namespace json
 } // namespace automation
 #endif
\ No newline at end of file
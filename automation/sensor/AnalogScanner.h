@@ -0,0 +1,130 @@
+#ifndef AUTOMATION_ANALOG_SCANNER_H
+#define AUTOMATION_ANALOG_SCANNER_H
+
+#include "../Automation.h"
+
+#include <stdint.h>
+
+namespace automation {
+
+  // Round robin accumulation of ADC conversions for a set of analog channels.  Hardware code calls 
+  // conversionComplete() when a conversion finishes (ADC interrupt on arduino or a simulated ADC on a
+  // host build) and starts a conversion on the channel it returns.  Sensors read averages with takeAverage().
+  class AnalogScanner {
+  public:
+    static const uint8_t MAX_CHANNELS = 16;
+
+    // Conversions kept each time a channel is visited.  One more is converted first and dropped because
+    // the sample and hold capacitor still has charge from the last channel (high impedance dividers).
+    static const uint8_t VISIT_CNT = 4, SETTLE_CNT = 1;
+
+    // Sum and count are halved at this count so an average follows recent values instead of growing forever
+    static const uint16_t MAX_ACCUMULATED_CNT = 1024; // enough for 4^4 oversampling
+
+    struct Accumulator {
+      uint8_t channel;
+      volatile uint32_t sum;
+      volatile uint16_t cnt;
+    };
+
+    AnalogScanner() : channelCnt(0), current(0), visitIndex(0), conversionCnt(0) {}
+
+    // Call before start.  Returns false if there is no room for another channel.
+    bool addChannel(uint8_t channel) {
+      if ( hasChannel(channel) ) {
+        return true;
+      }
+      if ( channelCnt >= MAX_CHANNELS ) {
+        return false;
+      }
+      InterruptLock lock;
+      Accumulator& acc = accumulators[channelCnt];
+      acc.channel = channel;
+      acc.sum = 0;
+      acc.cnt = 0;
+      channelCnt++;
+      return true;
+    }
+
+    bool hasChannel(uint8_t channel) const {
+      return find(channel) != nullptr;
+    }
+
+    uint8_t getChannelCnt() const { return channelCnt; }
+
+    uint8_t getCurrentChannel() const { return accumulators[current].channel; }
+
+    unsigned long getConversionCnt() const {
+      InterruptLock lock;
+      return conversionCnt;
+    }
+
+    // Restart the current visit (conversions were interrupted so settle again)
+    void resetVisit() { visitIndex = 0; }
+
+    // Record a finished conversion and return the next channel to convert.  Called from interrupt context.
+    uint8_t conversionComplete(uint16_t value) {
+      Accumulator& acc = accumulators[current];
+      if ( visitIndex++ < SETTLE_CNT ) {
+        return acc.channel;
+      }
+      acc.sum += value;
+      if ( ++acc.cnt >= MAX_ACCUMULATED_CNT ) {
+        acc.sum >>= 1;
+        acc.cnt >>= 1;
+      }
+      conversionCnt++;
+      if ( visitIndex >= SETTLE_CNT + VISIT_CNT ) {
+        visitIndex = 0;
+        if ( ++current >= channelCnt ) {
+          current = 0;
+        }
+      }
+      return accumulators[current].channel;
+    }
+
+    // Average of conversions since last call.  Returns false if channel not scanned or no conversions yet.
+    bool takeAverage(uint8_t channel, float& average) {
+      uint32_t sum;
+      uint16_t cnt;
+      if ( !take(channel,sum,cnt) ) {
+        return false;
+      }
+      average = (float) sum / cnt;
+      return true;
+    }
+
+    bool take(uint8_t channel, uint32_t& sum, uint16_t& cnt) {
+      Accumulator* pAcc = find(channel);
+      if ( !pAcc ) {
+        return false;
+      }
+      {
+        InterruptLock lock;
+        sum = pAcc->sum;
+        cnt = pAcc->cnt;
+        pAcc->sum = 0;
+        pAcc->cnt = 0;
+      }
+      return cnt > 0;
+    }
+
+  protected:
+    Accumulator accumulators[MAX_CHANNELS];
+    uint8_t channelCnt;
+    volatile uint8_t current, visitIndex;
+    volatile unsigned long conversionCnt;
+
+    Accumulator* find(uint8_t channel) const {
+      for ( uint8_t i = 0; i < channelCnt; i++ ) {
+        if ( accumulators[i].channel == channel ) {
+          return const_cast<Accumulator*>(&accumulators[i]);
+        }
+      }
+      return nullptr;
+    }
+  };
+
+}
+
+#endif
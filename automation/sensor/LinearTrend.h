@@ -0,0 +1,151 @@
+#ifndef AUTOMATION_LINEAR_TREND_H
+#define AUTOMATION_LINEAR_TREND_H
+
+#include "../Automation.h"
+
+#include <stdint.h>
+#include <math.h>
+
+namespace automation {
+
+  // Least squares line through the samples of a sliding time window.  Adding or expiring a sample updates 
+  // the sums in O(1).  Sums are 64 bit integers (milli units and 100ms ticks) so they never drift no matter 
+  // how many samples come and go.  Times are relative to a base moved forward (exactly) as the window slides.
+  class LinearTrend {
+  public:
+    static const int32_t SCALE = 1000;  // fixed point units per 1.0
+    static const uint16_t TICK_MS = 100;
+    static const uint8_t MIN_SAMPLE_CNT = 3;
+    static const int32_t MAX_ABS_VALUE = 2000000; // fits in 32 bits as milli units
+
+    LinearTrend(uint8_t capacity, unsigned long windowMs) :
+        capacity(capacity < MIN_SAMPLE_CNT ? MIN_SAMPLE_CNT : capacity) {
+      samples = new Sample[this->capacity];
+      setWindowMs(windowMs);
+    }
+
+    ~LinearTrend() {
+      delete[] samples;
+    }
+
+    void clear() {
+      count = 0;
+      sumT = sumV = sumTT = sumTV = 0;
+    }
+
+    // Samples closer together than window/capacity are skipped so the ring always covers the window.  
+    // Returns true if the sample was added.
+    bool add(float value, unsigned long timeMs = millisecs()) {
+      if ( isnan(value) || fabs(value) > MAX_ABS_VALUE ) {
+        return false;
+      }
+      if ( count > 0 && timeMs - newest().timeMs < minIntervalMs ) {
+        return false;
+      }
+      expire(timeMs);
+      if ( count == capacity ) {
+        remove();
+      }
+      if ( count == 0 ) {
+        baseMs = timeMs;
+      } else if ( timeMs - baseMs > 2 * windowMs ) {
+        rebase(oldest().timeMs);
+      }
+      Sample& s = samples[(first + count) % capacity];
+      s.timeMs = timeMs;
+      s.value = lround(value * SCALE);
+      count++;
+      int64_t t = toTicks(s.timeMs), v = s.value;
+      sumT += t;
+      sumV += v;
+      sumTT += t * t;
+      sumTV += t * v;
+      return true;
+    }
+
+    // Drop samples older than the window (call before reading if samples may have stopped)
+    void expire(unsigned long nowMs = millisecs()) {
+      while ( count > 0 && nowMs - oldest().timeMs > windowMs ) {
+        remove();
+      }
+    }
+
+    // Enough samples spread over at least a quarter of the window
+    bool isValid() const {
+      return count >= MIN_SAMPLE_CNT && getSpanMs() >= windowMs / 4 && getDenominator() > 0;
+    }
+
+    float getSlopePerMinute() const {
+      if ( !isValid() ) {
+        return NAN;
+      }
+      float slopePerTick = (float) (count * sumTV - sumT * sumV) / (float) getDenominator();
+      return slopePerTick * (60000 / TICK_MS) / SCALE;
+    }
+
+    // Value of the fitted line at timeMs (extrapolates past the newest sample)
+    float getValueAt(unsigned long timeMs) const {
+      if ( !isValid() ) {
+        return NAN;
+      }
+      float slopePerTick = (float) (count * sumTV - sumT * sumV) / (float) getDenominator();
+      float intercept = ((float) sumV - slopePerTick * (float) sumT) / count;
+      float ticks = (float) (long) (timeMs - baseMs) / TICK_MS;
+      return (intercept + slopePerTick * ticks) / SCALE;
+    }
+
+    unsigned long getWindowMs() const { return windowMs; }
+
+    void setWindowMs(unsigned long windowMs) {
+      this->windowMs = windowMs;
+      minIntervalMs = windowMs / capacity;
+    }
+
+    uint8_t getCount() const { return count; }
+
+    unsigned long getSpanMs() const { return count ? newest().timeMs - oldest().timeMs : 0; }
+
+  protected:
+    struct Sample {
+      unsigned long timeMs;
+      int32_t value; // milli units
+    };
+
+    Sample* samples;
+    uint8_t capacity;
+    uint8_t first = 0;
+    uint8_t count = 0;
+    unsigned long windowMs = 0, minIntervalMs = 0;
+    unsigned long baseMs = 0;
+    int64_t sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+
+    const Sample& oldest() const { return samples[first]; }
+    const Sample& newest() const { return samples[(first + count - 1) % capacity]; }
+
+    int64_t toTicks(unsigned long timeMs) const { return (long) (timeMs - baseMs) / TICK_MS; }
+
+    int64_t getDenominator() const { return count * sumTT - sumT * sumT; }
+
+    void remove() {
+      const Sample& s = oldest();
+      int64_t t = toTicks(s.timeMs), v = s.value;
+      sumT -= t;
+      sumV -= v;
+      sumTT -= t * t;
+      sumTV -= t * v;
+      first = (first + 1) % capacity;
+      count--;
+    }
+
+    // Shifting every t by d changes the sums by known amounts
+    void rebase(unsigned long newBaseMs) {
+      int64_t d = toTicks(newBaseMs);
+      sumTT += -2 * d * sumT + count * d * d;
+      sumTV -= d * sumV;
+      sumT -= count * d;
+      baseMs += d * TICK_MS;
+    }
+  };
+
+}
+#endif
@@ -4,6 +4,8 @@
 #include "../Automation.h"
 #include "../json/JsonStreamWriter.h"
 #include "../AttributeContainer.h"
+#include "../Profiler.h"
+#include "SensorHistory.h"
 
 #include <string>
 #include <vector>
@@ -22,14 +24,51 @@ namespace automation {
     }
   };
 
+  class Sensor;
+
+  // Notified with the value of each sampling epoch Sensors publishes.  Listeners are chained through 
+  // pNextListener so adding one does not allocate.
+  struct SensorEpochListener {
+    SensorEpochListener* pNextListener = nullptr;
+
+    virtual void epochPublished(const Sensor& sensor, float value) = 0;
+    virtual ~SensorEpochListener() {}
+  };
+
   class Sensor : public ValueHolder<float>, public NamedContainer {
   public:    
     RTTI_GET_TYPE_DECL;
 
     enum State { Undefined = 0, Initialized = 0x01, ValueCached = 0x02, NotSampleable = 0x04, NotCacheable = 0x08, Error = 0x0F };
 
+    typedef unsigned long Generation;
+
+    // A cached value is only valid while its generation matches this one so incrementing it
+    // invalidates every sensor at once (no need to visit each sensor)
+    static Generation& currentGeneration() {
+      static Generation generation = 1;
+      return generation;
+    }
+
+    static void invalidateAll() {
+      currentGeneration()++;
+    }
+
+    // Adaptive sampling replaces sampleCnt with a count derived from recent sample variance.  Noisy
+    // sensors get up to MAX_ADAPTIVE_FACTOR*sampleCnt samples (bounded by the epoch time budget) and
+    // quiet ones drop to MIN_ADAPTIVE_SAMPLE_CNT (2 so variance can still be measured).  Epochs of a
+    // single sample estimate variance from the change since the previous epoch.
+    static const uint16_t MIN_ADAPTIVE_SAMPLE_CNT = 2, MAX_ADAPTIVE_FACTOR = 4;
+
+    // Standard error of the average that is good enough when sampleTolerance is 0 (relative to value)
+    static constexpr float DEFAULT_RELATIVE_TOLERANCE = 0.002;
+
     uint16_t sampleCnt;
     uint16_t sampleIntervalMs;
+    bool bAdaptiveSampling = false;
+    float sampleTolerance = 0; // in sensor units (0 for DEFAULT_RELATIVE_TOLERANCE)
+    SensorHistory* pHistory = nullptr; // optional, values recorded when Sensors publishes an epoch
+    SensorEpochListener* pEpochListeners = nullptr; // also called when Sensors publishes an epoch
 
     Sensor(const std::string& name, uint16_t sampleCnt=1, uint16_t sampleIntervalMs=35) : 
       NamedContainer(name),  
@@ -46,13 +85,42 @@ namespace automation {
       setInitialized(true);
     }
 
+    // Call from setup() only... history memory is allocated once here
+    Sensor& enableHistory(uint8_t capacity, uint16_t minIntervalSec = 15, uint16_t window1Sec = 60, uint16_t window2Sec = 5*60, uint16_t window3Sec = 15*60) {
+      if ( !pHistory ) {
+        pHistory = new SensorHistory(capacity, minIntervalSec, window1Sec, window2Sec, window3Sec);
+      }
+      return *this;
+    }
+
+    void addEpochListener(SensorEpochListener* pListener) {
+      pListener->pNextListener = pEpochListeners;
+      pEpochListeners = pListener;
+    }
+
+    void removeEpochListener(SensorEpochListener* pListener) {
+      for ( SensorEpochListener** ppNext = &pEpochListeners; *ppNext; ppNext = &(*ppNext)->pNextListener ) {
+        if ( *ppNext == pListener ) {
+          *ppNext = pListener->pNextListener;
+          pListener->pNextListener = nullptr;
+          return;
+        }
+      }
+    }
+
     virtual void reset()
     {
       setValueCached(false);
-      setError(false);
+      resetStatus();
       cachedValue = 0;
     }
 
+    // Clear error state without dropping the cached value (sampling epochs keep the last value readable)
+    virtual void resetStatus()
+    {
+      setError(false);
+    }
+
     void setInitialized(bool bInitialized) {
       if ( bInitialized ) {
         state |= State::Initialized;
@@ -87,12 +155,60 @@ namespace automation {
 
     bool isInitialized() const { return (state & State::Initialized) > 0; }
     bool isError() const { return (state & State::Error) > 0; }
-    bool isValueCached() const { return (state & State::NotCacheable ) == 0 && (state & State::ValueCached) > 0; }
+    bool isValueCached() const { 
+      return (state & State::NotCacheable ) == 0 && (state & State::ValueCached) > 0 && cachedGeneration == currentGeneration(); 
+    }
     bool canSample() const { return ( state & State::NotSampleable) == 0; }
+    bool isCacheable() const { return (state & State::NotCacheable) == 0; }
+
+    // Number of getValueImpl() calls averaged for one value
+    virtual uint16_t getSampleCnt() const { 
+      return bAdaptiveSampling && adaptiveSampleCnt ? adaptiveSampleCnt : sampleCnt; 
+    }
+
+    uint16_t getAdaptiveSampleCnt() const { return adaptiveSampleCnt; }
+    float getSampleVariance() const { return sampleVariance; }
+
+    // Called when an epoch is published with the statistics of the samples averaged
+    void adaptSampleCnt(uint16_t cnt, float mean, float variance, uint16_t budgetMs) {
+      if ( !bAdaptiveSampling || isnan(mean) ) {
+        return;
+      }
+      float previousMean = lastEpochMean;
+      lastEpochMean = mean;
+      if ( cnt < 2 ) {
+        if ( isnan(previousMean) ) {
+          return;
+        }
+        float delta = mean - previousMean;
+        variance = delta * delta / 2; // successive differences (drift between epochs counts as noise)
+      }
+      sampleVariance = adaptiveSampleCnt ? sampleVariance + (variance - sampleVariance) / 4 : variance;
+      float tolerance = sampleTolerance > 0 ? sampleTolerance : fabs(mean) * DEFAULT_RELATIVE_TOLERANCE;
+      uint16_t maxCnt = sampleCnt * MAX_ADAPTIVE_FACTOR;
+      if ( sampleIntervalMs > 0 && budgetMs / sampleIntervalMs < maxCnt ) {
+        maxCnt = budgetMs / sampleIntervalMs;
+      }
+      if ( maxCnt < MIN_ADAPTIVE_SAMPLE_CNT ) {
+        maxCnt = MIN_ADAPTIVE_SAMPLE_CNT;
+      }
+      // standard error of the average is sqrt(variance/cnt)
+      float neededCnt = tolerance > 0 ? ceil(sampleVariance / (tolerance * tolerance)) : maxCnt;
+      if ( neededCnt > maxCnt ) {
+        adaptiveSampleCnt = maxCnt;
+      } else if ( neededCnt < MIN_ADAPTIVE_SAMPLE_CNT ) {
+        adaptiveSampleCnt = MIN_ADAPTIVE_SAMPLE_CNT;
+      } else {
+        adaptiveSampleCnt = neededCnt;
+      }
+    }
+
+    PROFILE_COUNTER(getValueProfile)
 
     float getValue() const override {
+      PROFILE_SCOPE(getValueProfile)
       if ( !isValueCached() ) {     
-        float val = sample(this, &Sensor::getValueImpl, sampleCnt, sampleIntervalMs);
+        float val = sample(this, &Sensor::getValueImpl, getSampleCnt(), sampleIntervalMs);
         setCachedValue(val);        
       }
       return cachedValue;
@@ -100,24 +216,10 @@ namespace automation {
     
     virtual float getValueImpl() const = 0;
 
-    virtual void print(json::JsonStreamWriter& w, bool bVerbose=false, bool bIncludePrefix=true) const override;
+    // Called on every loop() for sensors that do background work between samples
+    virtual void poll() {}
 
-    // Returns false if sample was not done because smapleIntervalMs not elapsed
-    bool doSingleSample(int sampleIndex, Timer& lastSampleTimer) {
-      if ( sampleIndex <= 1 ) {
-        reset();
-        cachedValue = getValueImpl();
-      } else if ( lastSampleTimer.isExpiredMs(sampleIntervalMs) ) {
-        lastSampleTimer.reset();
-        cachedValue += getValueImpl(); // Note: the state of sensor is not "ValueCached" until all samples read and averaged
-      } else {
-        return false;
-      }    
-      if ( sampleIndex % sampleCnt == 0 ) {
-        setCachedValue( cachedValue / sampleCnt );
-      }
-      return true;
-    }
+    virtual void print(json::JsonStreamWriter& w, bool bVerbose=false, bool bIncludePrefix=true) const override;
 
     template<typename ObjectPtr,typename MethodPtr>
     static float sample(ObjectPtr pObj, MethodPtr pMethod, unsigned int cnt = 5, unsigned int intervalMs = 50)
@@ -151,8 +253,14 @@ namespace automation {
     static float delta(const vector<Sensor*>& sensors);
 
   protected:
+    friend class Sensors; // publishes sampled values at the end of a sampling epoch
+
     mutable unsigned char state = State::Undefined; // mutable because cached state can change even on a getValue()
     mutable float cachedValue;
+    mutable Generation cachedGeneration = 0;
+    uint16_t adaptiveSampleCnt = 0; // 0 until first adaptive epoch
+    float sampleVariance = 0; // smoothed across epochs
+    float lastEpochMean = NAN; // for variance of single sample epochs
 
     void setValueCached(bool bCached) const {
       if ( bCached ) {
@@ -165,6 +273,7 @@ namespace automation {
 
     void setCachedValue(float v) const {
       cachedValue = v;
+      cachedGeneration = currentGeneration();
       setValueCached(true);
     }
   };
@@ -207,32 +316,76 @@ namespace automation {
       transformFn(transformFn),
       transformName(transformName)
     {
+      setCanSample(false); // cached per generation like CompositeSensor
     }
     
-    virtual float getValue() const override
+    float getValueImpl() const override
     {
       return transformFn(sourceSensor.getValue());
     }
 
   };
 
+  // Accumulates the samples of one sensor without blocking.  The average is not written to the sensor
+  // until Sensors publishes the whole epoch so readers never see a partially sampled value.
   struct SensorSampler {
     Sensor* pSensor;
-    int sampleIndex;
-    Timer lastSampleTimer;
-
-    SensorSampler(Sensor* s):pSensor(s), sampleIndex(1){}
+    uint16_t sampleIndex;
+    uint16_t targetCnt; // fixed for the epoch (adaptive count can change when the epoch is published)
+    float sampleSum;
+    float mean, m2; // running variance (Welford) for adaptive sampling
+    TimerVal nextDueMs;
+
+    SensorSampler(Sensor* s):pSensor(s), sampleIndex(0), targetCnt(1), sampleSum(0), mean(0), m2(0), nextDueMs(0){}
+
+    void begin(TimerVal nowMs) {
+      sampleIndex = 0;
+      uint16_t cnt = pSensor->getSampleCnt();
+      targetCnt = cnt == 0 ? 1 : cnt;
+      sampleSum = 0;
+      mean = 0;
+      m2 = 0;
+      nextDueMs = nowMs;
+    }
 
-    bool doSingleSample() {
-      if ( pSensor->doSingleSample(sampleIndex,lastSampleTimer) ) {
-        sampleIndex++;
+    // Returns false if sample was not done because sampleIntervalMs not elapsed
+    bool doSingleSample(TimerVal nowMs) {
+      if ( isComplete() || nowMs < nextDueMs ) {
+        return false;
+      }
+      if ( sampleIndex == 0 ) {
+        pSensor->resetStatus();
+      }
+      float sampleVal = pSensor->getValueImpl();
+      if ( isnan(sampleVal) ) {
+        // same as Sensor::sample()... a NaN ends sampling and becomes the value
+        sampleSum = sampleVal;
+        sampleIndex = getSampleCnt();
         return true;
       }
-      return false;
+      sampleSum += sampleVal;
+      sampleIndex++;
+      float delta = sampleVal - mean;
+      mean += delta / sampleIndex;
+      m2 += delta * (sampleVal - mean);
+      nextDueMs = nowMs + pSensor->sampleIntervalMs;
+      return true;
+    }
+
+    uint16_t getSampleCnt() const {
+      return targetCnt;
+    }
+
+    float getVariance() const {
+      return sampleIndex > 1 ? m2 / (sampleIndex - 1) : 0;
     }
 
     bool isComplete() const {
-      return pSensor->isValueCached();// || sampleIndex >= pSensor->sampleCnt;
+      return sampleIndex >= getSampleCnt();
+    }
+
+    float getAverage() const {
+      return sampleIndex == 0 ? sampleSum : sampleSum / sampleIndex;
     }
   };
 
@@ -242,31 +395,95 @@ namespace automation {
     Sensors( vector<Sensor*>& sensors ) : AttributeContainerVector<Sensor*>(sensors) {}
     Sensors( vector<Sensor*> sensors ) : AttributeContainerVector<Sensor*>(sensors) {}
     
+    // Clear cached values of all sensors (not just the ones in this list)
     void reset() {
+      Sensor::invalidateAll();
+    }
+
+    // Longest time (sampleCnt*sampleIntervalMs) an adaptive sensor may use in one epoch
+    uint16_t sampleBudgetMs = 2000;
+
+    void poll() {
       for( Sensor* pSensor : *this ) {
-        pSensor->reset();
+        pSensor->poll();
+      }
+    }
+
+    // Start a sampling epoch.  Ignored if one is already in progress.  Sensor values from the last
+    // published epoch stay readable until the new epoch completes.
+    void beginSampling() {
+      if ( bSampling ) {
+        return;
+      }
+      if ( samplers.empty() ) {
+        for( Sensor* pSensor : *this ) {
+          if ( pSensor->canSample() ) {
+            samplers.push_back( SensorSampler(pSensor) );
+          }
+        }
       }
+      TimerVal nowMs = millisecs64();
+      for( SensorSampler& sampler : samplers ) {
+        sampler.begin(nowMs);
+      }
+      bSampling = true;
     }
 
+    bool isSampling() const { return bSampling; }
+
+    unsigned long getSampleEpoch() const { return sampleEpoch; }
+
+    // Take the samples that are due and return.  Returns true when the epoch completed and was published.
+    bool sampleTick() {
+      if ( !bSampling ) {
+        return false;
+      }
+      TimerVal nowMs = millisecs64();
+      bool bComplete = true;
+      for( SensorSampler& sampler : samplers ) {
+        sampler.doSingleSample(nowMs);
+        bComplete = bComplete && sampler.isComplete();
+      }
+      if ( bComplete ) {
+        publishSamples();
+      }
+      return bComplete;
+    }
+
+    // Blocking version for callers that need fresh values right away (setup)
     void getValuesBySampling() 
     {
-      std::vector<SensorSampler> sampleVec;
-      
-      for( Sensor* pSensor : *this ) {
-        if ( pSensor->canSample() ) {
-          sampleVec.push_back( SensorSampler(pSensor) );
-        }
+      beginSampling();
+      while( !sampleTick() ) {
+        poll(); // background work such as continuous conversions and energy meters
+        automation::threadKeepAliveReset();
       }
+    }
 
-      while( !sampleVec.empty() ) {
-        for( SensorSampler& sampler : sampleVec) {
-          sampler.doSingleSample();
+  protected:
+    std::vector<SensorSampler> samplers; // built once on first epoch
+    bool bSampling = false;
+    unsigned long sampleEpoch = 0;
+
+    void publishSamples() {
+      Sensor::invalidateAll(); // composite and derived sensors recompute once from the new values
+      for( SensorSampler& sampler : samplers ) {
+        float average = sampler.getAverage();
+        sampler.pSensor->setCachedValue(average);
+        sampler.pSensor->adaptSampleCnt(sampler.sampleIndex, average, sampler.getVariance(), sampleBudgetMs);
+      }
+      for( Sensor* pSensor : *this ) {
+        if ( pSensor->pHistory ) {
+          pSensor->pHistory->add( pSensor->getValue() );
+        }
+        for ( SensorEpochListener* pListener = pSensor->pEpochListeners; pListener; pListener = pListener->pNextListener ) {
+          pListener->epochPublished(*pSensor, pSensor->getValue());
         }
-        sampleVec.erase( std::remove_if(sampleVec.begin(),sampleVec.end(), [](const SensorSampler& ss){return ss.isComplete();}), sampleVec.end());
-      };
+      }
+      sampleEpoch++;
+      bSampling = false;
     }
 
-
   };
 
 }
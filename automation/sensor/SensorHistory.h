@@ -0,0 +1,241 @@
+#ifndef AUTOMATION_SENSOR_HISTORY_H
+#define AUTOMATION_SENSOR_HISTORY_H
+
+#include "../Automation.h"
+#include "../json/JsonStreamWriter.h"
+
+#include <stdint.h>
+#include <math.h>
+
+namespace automation {
+
+  // Ring of recent sensor values with sum, min and max kept for a few trailing time windows.  Sums
+  // slide and min/max use monotonic deques so adding a value or reading a window is O(1) amortized.
+  // All memory is allocated in the constructor.
+  class SensorHistory {
+  public:
+    static const uint8_t WINDOW_CNT = 3;
+    static const uint8_t INTERVAL_TOLERANCE_DIV = 8; // epochs up to 1/8 of minIntervalSec early are kept
+
+    struct Sample {
+      uint16_t timeSec; // wraps every 18 hours which is fine for windows of minutes
+      float value;
+    };
+
+    // Fixed capacity deque of ring indexes
+    struct IndexDeque {
+      uint8_t* buf;
+      uint8_t capacity, head, size;
+
+      void init(uint8_t* pBuf, uint8_t cap) { buf = pBuf; capacity = cap; head = 0; size = 0; }
+      bool empty() const { return size == 0; }
+      uint8_t front() const { return buf[head]; }
+      uint8_t back() const { return buf[(head + size - 1) % capacity]; }
+      void popFront() { head = (head + 1) % capacity; size--; }
+      void popBack() { size--; }
+      void pushBack(uint8_t i) { buf[(head + size) % capacity] = i; size++; }
+    };
+
+    struct Window {
+      uint16_t durationSec;
+      uint8_t capacity; // most samples that fit in durationSec given getMinIntervalMs()
+      uint8_t cnt;
+      uint8_t oldest;   // ring index of oldest sample in window
+      float sum;
+      IndexDeque minQ, maxQ;
+
+      float getAverage() const { return cnt ? sum / cnt : NAN; }
+    };
+
+    SensorHistory(uint8_t capacity, uint16_t minIntervalSec = 15, uint16_t window1Sec = 60, uint16_t window2Sec = 5*60, uint16_t window3Sec = 15*60) :
+        capacity(capacity ? capacity : 1),
+        minIntervalSec(minIntervalSec),
+        next(0),
+        count(0),
+        lastAddMs(0) {
+      samples = new Sample[this->capacity];
+      uint16_t durations[WINDOW_CNT] = { window1Sec, window2Sec, window3Sec };
+      uint16_t dequeSize = 0;
+      for ( uint8_t i = 0; i < WINDOW_CNT; i++ ) {
+        windows[i].durationSec = durations[i];
+        uint32_t minIntervalMs = getMinIntervalMs();
+        uint32_t windowCapacity = minIntervalMs ? durations[i] * 1000ul / minIntervalMs + 1 : this->capacity;
+        windows[i].capacity = windowCapacity > this->capacity ? this->capacity : windowCapacity;
+        dequeSize += 2*windows[i].capacity;
+      }
+      dequeBuf = new uint8_t[dequeSize];
+      uint8_t* pBuf = dequeBuf;
+      for ( Window& w : windows ) {
+        w.minQ.init(pBuf, w.capacity);
+        pBuf += w.capacity;
+        w.maxQ.init(pBuf, w.capacity);
+        pBuf += w.capacity;
+        w.cnt = 0;
+        w.oldest = 0;
+        w.sum = 0;
+      }
+    }
+
+    ~SensorHistory() {
+      delete[] samples;
+      delete[] dequeBuf;
+    }
+
+    static uint16_t nowSec() {
+      return (uint16_t) (millisecs64() / 1000);
+    }
+
+    // Returns false if the value was skipped (NaN or less than getMinIntervalMs() since last value).
+    // Epoch length varies with sampling so the interval is compared in milliseconds with some tolerance.
+    bool add(float value, uint64_t timeMs = millisecs64()) {
+      if ( isnan(value) || (count && (uint32_t)timeMs - lastAddMs < getMinIntervalMs()) ) {
+        return false;
+      }
+      uint16_t timeSec = (uint16_t) (timeMs / 1000);
+      uint8_t slot = next;
+      if ( count == capacity ) {
+        // oldest sample is overwritten so it leaves every window still holding it
+        for ( Window& w : windows ) {
+          if ( w.cnt && w.oldest == slot ) {
+            removeOldest(w);
+          }
+        }
+      }
+      samples[slot].timeSec = timeSec;
+      samples[slot].value = value;
+      next = (next + 1) % capacity;
+      if ( count < capacity ) {
+        count++;
+      }
+      lastAddMs = (uint32_t) timeMs;
+      for ( Window& w : windows ) {
+        expire(w,timeSec);
+        if ( w.cnt == w.capacity ) {
+          removeOldest(w);
+        }
+        if ( w.cnt == 0 ) {
+          w.oldest = slot;
+          w.sum = 0; // drop accumulated rounding error whenever a window empties
+        }
+        w.sum += value;
+        w.cnt++;
+        while ( !w.minQ.empty() && samples[w.minQ.back()].value >= value ) {
+          w.minQ.popBack();
+        }
+        w.minQ.pushBack(slot);
+        while ( !w.maxQ.empty() && samples[w.maxQ.back()].value <= value ) {
+          w.maxQ.popBack();
+        }
+        w.maxQ.pushBack(slot);
+      }
+      if ( next == 0 ) {
+        resum(); // once per trip around the ring so float sums do not drift
+      }
+      return true;
+    }
+
+    // Drop samples that aged out and return window (index 0 is shortest)
+    const Window& getWindow(uint8_t i, uint16_t timeSec = nowSec()) {
+      expire(windows[i],timeSec);
+      return windows[i];
+    }
+
+    float getMin(const Window& w) const { return w.cnt ? samples[w.minQ.front()].value : NAN; }
+    float getMax(const Window& w) const { return w.cnt ? samples[w.maxQ.front()].value : NAN; }
+
+    uint8_t getCount() const { return count; }
+    uint8_t getCapacity() const { return capacity; }
+    uint16_t getMinIntervalSec() const { return minIntervalSec; }
+    uint32_t getMinIntervalMs() const {
+      uint32_t ms = minIntervalSec * 1000ul;
+      return ms - ms / INTERVAL_TOLERANCE_DIV;
+    }
+
+    void print(json::JsonStreamWriter& w, bool bVerbose = false) {
+      uint16_t timeSec = nowSec();
+      w.noPrefixPrintln("{");
+      w.increaseDepth();
+      w.printlnNumberObj(F("capacity"), (int) capacity, ",");
+      w.printlnNumberObj(F("count"), (int) count, ",");
+      w.printlnNumberObj(F("minIntervalSec"), minIntervalSec, ",");
+      if ( bVerbose ) {
+        w.printKey(F("samples"));
+        w.noPrefixPrint("[");
+        for ( uint8_t i = 0; i < count; i++ ) {
+          const Sample& s = samples[(next + capacity - count + i) % capacity];
+          if ( i > 0 ) {
+            w.noPrefixPrint(",");
+          }
+          w.noPrefixPrint("[");
+          w.noPrefixPrint((uint16_t)(timeSec - s.timeSec));
+          w.noPrefixPrint(",");
+          w.noPrefixPrint(s.value);
+          w.noPrefixPrint("]");
+        }
+        w.noPrefixPrintln("],");
+      }
+      w.printKey(F("windows"));
+      w.noPrefixPrintln("[");
+      w.increaseDepth();
+      for ( uint8_t i = 0; i < WINDOW_CNT; i++ ) {
+        const Window& win = getWindow(i,timeSec);
+        w.println("{");
+        w.increaseDepth();
+        w.printlnNumberObj(F("durationSec"), win.durationSec, ",");
+        w.printlnNumberObj(F("cnt"), (int) win.cnt, win.cnt ? "," : "");
+        if ( win.cnt ) {
+          w.printlnNumberObj(F("avg"), win.getAverage(), ",");
+          w.printlnNumberObj(F("min"), getMin(win), ",");
+          w.printlnNumberObj(F("max"), getMax(win));
+        }
+        w.decreaseDepth();
+        w.print("}");
+        w.noPrefixPrintln(i + 1 < WINDOW_CNT ? "," : "");
+      }
+      w.decreaseDepth();
+      w.println("]");
+      w.decreaseDepth();
+      w.print("}");
+    }
+
+  protected:
+    Sample* samples;
+    uint8_t* dequeBuf;
+    Window windows[WINDOW_CNT];
+    uint8_t capacity;
+    uint16_t minIntervalSec;
+    uint8_t next, count;
+    uint32_t lastAddMs;
+
+    void removeOldest(Window& w) {
+      uint8_t slot = w.oldest;
+      w.sum -= samples[slot].value;
+      w.cnt--;
+      w.oldest = (slot + 1) % capacity;
+      if ( !w.minQ.empty() && w.minQ.front() == slot ) {
+        w.minQ.popFront();
+      }
+      if ( !w.maxQ.empty() && w.maxQ.front() == slot ) {
+        w.maxQ.popFront();
+      }
+    }
+
+    void expire(Window& w, uint16_t timeSec) {
+      while ( w.cnt && (uint16_t)(timeSec - samples[w.oldest].timeSec) >= w.durationSec ) {
+        removeOldest(w);
+      }
+    }
+
+    void resum() {
+      for ( Window& w : windows ) {
+        w.sum = 0;
+        for ( uint8_t i = 0, slot = w.oldest; i < w.cnt; i++, slot = (slot + 1) % capacity ) {
+          w.sum += samples[slot].value;
+        }
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef AUTOMATION_TRAPEZOID_INTEGRATOR_H
+#define AUTOMATION_TRAPEZOID_INTEGRATOR_H
+
+#include "../Automation.h"
+
+#include <stdint.h>
+#include <math.h>
+
+namespace automation {
+
+  // Integrates a signed value over time (amps to amp hours, watts to watt hours) keeping positive and 
+  // negative areas apart.  A segment that crosses zero is split where it crosses.  Totals are 64 bit 
+  // fixed point (milli units times milliseconds, doubled) so months of samples do not lose precision.
+  class TrapezoidIntegrator {
+  public:
+    static const int32_t SCALE = 1000; // fixed point units per 1.0
+
+    TrapezoidIntegrator() { reset(); }
+
+    void reset() {
+      positive = 0;
+      negative = 0;
+      bHavePrev = false;
+    }
+
+    // NaN values are skipped and the next segment spans the gap
+    void add(float value, TimerVal timeMs) {
+      if ( isnan(value) ) {
+        return;
+      }
+      int32_t v = lround(value * SCALE);
+      if ( bHavePrev && timeMs > prevMs ) {
+        accumulate(prev, v, (int64_t)(timeMs - prevMs));
+      }
+      prev = v;
+      prevMs = timeMs;
+      bHavePrev = true;
+    }
+
+    float getPositiveHours() const { return toHours(positive); }
+    float getNegativeHours() const { return toHours(negative); }
+
+  protected:
+    int64_t positive, negative; // doubled area (trapezoid halving deferred to toHours)
+    int32_t prev;
+    TimerVal prevMs;
+    bool bHavePrev;
+
+    void accumulate(int64_t a, int64_t b, int64_t dtMs) {
+      if ( a >= 0 && b >= 0 ) {
+        positive += (a + b) * dtMs;
+      } else if ( a <= 0 && b <= 0 ) {
+        negative -= (a + b) * dtMs;
+      } else if ( a > 0 ) {
+        // triangles either side of the zero crossing at dtMs*a/(a-b)
+        positive += a * a * dtMs / (a - b);
+        negative += b * b * dtMs / (a - b);
+      } else {
+        negative += a * a * dtMs / (b - a);
+        positive += b * b * dtMs / (b - a);
+      }
+    }
+
+    static float toHours(int64_t doubledArea) {
+      return (float) (doubledArea / 2 / SCALE) / 3600000.0;
+    }
+  };
+
+}
+
+#endif
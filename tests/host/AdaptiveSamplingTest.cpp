@@ -0,0 +1,74 @@
+// Adaptive sampling must raise the sample count of a noisy sensor and lower it for a quiet one without
+// an epoch taking longer than Sensors::sampleBudgetMs.  Sensors that take a single sample per epoch
+// (the ADS1115 current sensor in the sketch) estimate variance from successive epochs.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/sensor/Sensor.cpp"
+
+#include <cstdlib>
+
+using namespace automation;
+
+float noise(float amplitude) { return amplitude * (rand() % 2001 - 1000) / 1000.0; }
+
+float getNoisyValue() { return 100 + noise(5); }
+float getQuietValue() { return 100 + noise(0.01); }
+float getNoisySingleValue() { return 10 + noise(0.5); }
+
+// Runs epochs to completion like loop() and returns the longest epoch
+unsigned long runEpochs(Sensors& sensors, int epochCnt) {
+  unsigned long maxEpochMs = 0;
+  for ( int i = 0; i < epochCnt; i++ ) {
+    host::nowMs += 5*SECONDS;
+    unsigned long startMs = host::nowMs;
+    sensors.beginSampling();
+    while ( !sensors.sampleTick() ) {
+      host::nowMs += 5;
+    }
+    unsigned long epochMs = host::nowMs - startMs;
+    maxEpochMs = epochMs > maxEpochMs ? epochMs : maxEpochMs;
+  }
+  return maxEpochMs;
+}
+
+void testAdaptiveCounts() {
+  SensorFn noisy("Noisy", getNoisyValue);
+  SensorFn quiet("Quiet", getQuietValue);
+  SensorFn noisySingle("Noisy Single", getNoisySingleValue);
+  noisy.sampleCnt = 10;
+  noisy.sampleIntervalMs = 100;
+  quiet.sampleCnt = 10;
+  quiet.sampleIntervalMs = 100;
+  noisySingle.sampleCnt = 1;
+  Sensors sensors({&noisy, &quiet, &noisySingle});
+  for ( Sensor* pSensor : sensors ) {
+    pSensor->bAdaptiveSampling = true;
+  }
+  srand(10);
+
+  runEpochs(sensors, 1); // first epoch runs sampleCnt samples
+  unsigned long maxEpochMs = runEpochs(sensors, 20);
+  CHECK(noisy.getSampleCnt() > noisy.sampleCnt);
+  CHECK(quiet.getSampleCnt() < quiet.sampleCnt);
+  CHECK(quiet.getSampleCnt() == Sensor::MIN_ADAPTIVE_SAMPLE_CNT);
+  CHECK(noisySingle.getSampleCnt() > noisySingle.sampleCnt);
+  CHECK(noisy.getSampleCnt() * noisy.sampleIntervalMs <= sensors.sampleBudgetMs);
+  CHECK(maxEpochMs <= sensors.sampleBudgetMs);
+  std::printf("  noisy %u->%u, quiet %u->%u, noisy single %u->%u samples, longest epoch %lums (budget %ums)\n",
+      noisy.sampleCnt, noisy.getSampleCnt(), quiet.sampleCnt, quiet.getSampleCnt(),
+      noisySingle.sampleCnt, noisySingle.getSampleCnt(), maxEpochMs, sensors.sampleBudgetMs);
+
+  // Smaller budget caps the noisy sensor below MAX_ADAPTIVE_FACTOR*sampleCnt
+  sensors.sampleBudgetMs = 1000;
+  runEpochs(sensors, 1); // still uses the count adapted to the old budget
+  maxEpochMs = runEpochs(sensors, 5);
+  CHECK(noisy.getSampleCnt() == 10);
+  CHECK(maxEpochMs <= sensors.sampleBudgetMs);
+}
+
+int main() {
+  testAdaptiveCounts();
+  return host::finish("AdaptiveSamplingTest");
+}
@@ -0,0 +1,156 @@
+// AnalogScanner driven by a simulated ADC: round robin visits, settle conversions, the take() snapshot
+// and reset, MAX_ACCUMULATED_CNT halving and a benchmark against blocking analogRead() sampling.
+
+#include "HostTest.h"
+#include "automation/sensor/AnalogScanner.h"
+
+using namespace automation;
+
+// Converts whatever channel the scanner asks for.  The first conversion after a channel switch still
+// reads the previous channel (sample and hold charge) like the high impedance dividers on the board.
+struct SimAdc {
+  uint16_t values[AnalogScanner::MAX_CHANNELS] = {0};
+  uint8_t lastChannel = 0xFF;
+  unsigned long conversionCnt = 0;
+
+  void run(AnalogScanner& scanner, unsigned long cnt) {
+    uint8_t channel = scanner.getCurrentChannel();
+    for ( unsigned long i = 0; i < cnt; i++ ) {
+      uint16_t value = channel != lastChannel && lastChannel != 0xFF ? values[lastChannel] : values[channel];
+      lastChannel = channel;
+      conversionCnt++;
+      channel = scanner.conversionComplete(value);
+    }
+  }
+};
+
+void testRoundRobin() {
+  AnalogScanner scanner;
+  CHECK(scanner.addChannel(3));
+  CHECK(scanner.addChannel(5));
+  CHECK(scanner.addChannel(3)); // already scanned
+  CHECK(scanner.getChannelCnt() == 2);
+  CHECK(scanner.getCurrentChannel() == 3);
+
+  const uint8_t visitLen = AnalogScanner::SETTLE_CNT + AnalogScanner::VISIT_CNT;
+  uint8_t channel = 0;
+  for ( uint8_t i = 0; i < visitLen; i++ ) {
+    channel = scanner.conversionComplete(100);
+  }
+  CHECK(channel == 5);
+  for ( uint8_t i = 0; i < visitLen; i++ ) {
+    channel = scanner.conversionComplete(200);
+  }
+  CHECK(channel == 3);
+  CHECK(scanner.getConversionCnt() == 2*AnalogScanner::VISIT_CNT); // settle conversions are not counted
+}
+
+void testSettleConversionsDropped() {
+  AnalogScanner scanner;
+  SimAdc adc;
+  scanner.addChannel(0);
+  scanner.addChannel(1);
+  adc.values[0] = 100;
+  adc.values[1] = 900;
+  adc.run(scanner, 100*(AnalogScanner::SETTLE_CNT + AnalogScanner::VISIT_CNT));
+
+  float average = 0;
+  CHECK(scanner.takeAverage(0, average));
+  CHECK(average == 100);
+  CHECK(scanner.takeAverage(1, average));
+  CHECK(average == 900);
+}
+
+void testTakeSnapshotAndReset() {
+  AnalogScanner scanner;
+  SimAdc adc;
+  scanner.addChannel(2);
+  adc.values[2] = 512;
+
+  uint32_t sum = 0;
+  uint16_t cnt = 0;
+  float average;
+  CHECK(!scanner.take(2, sum, cnt)); // nothing converted yet
+  CHECK(!scanner.takeAverage(7, average)); // not scanned
+
+  adc.run(scanner, 10*(AnalogScanner::SETTLE_CNT + AnalogScanner::VISIT_CNT));
+  CHECK(scanner.take(2, sum, cnt));
+  CHECK(cnt == 10*AnalogScanner::VISIT_CNT);
+  CHECK(sum == 512ul*cnt);
+
+  // take() cleared the accumulator so only newer conversions are averaged
+  CHECK(!scanner.take(2, sum, cnt));
+  adc.values[2] = 10;
+  adc.run(scanner, AnalogScanner::SETTLE_CNT + AnalogScanner::VISIT_CNT);
+  CHECK(scanner.takeAverage(2, average));
+  CHECK(average == 10);
+}
+
+void testSaturation() {
+  AnalogScanner scanner;
+  SimAdc adc;
+  scanner.addChannel(0);
+  adc.values[0] = 1023;
+
+  // well past MAX_ACCUMULATED_CNT at full scale so an unbounded sum would have overflowed 32 bits
+  adc.run(scanner, 5000000);
+  uint32_t sum = 0;
+  uint16_t cnt = 0;
+  CHECK(scanner.take(0, sum, cnt));
+  CHECK(cnt < AnalogScanner::MAX_ACCUMULATED_CNT);
+  CHECK(cnt >= AnalogScanner::MAX_ACCUMULATED_CNT/2);
+  CHECK(sum == 1023ul*cnt);
+
+  // halving keeps recent values: after a step the average moves toward the new value
+  adc.values[0] = 1023;
+  adc.run(scanner, 3*AnalogScanner::MAX_ACCUMULATED_CNT/2);
+  adc.values[0] = 0;
+  adc.run(scanner, AnalogScanner::MAX_ACCUMULATED_CNT);
+  float average = 0;
+  CHECK(scanner.takeAverage(0, average));
+  CHECK(average < 1023/2.0);
+}
+
+// Blocking sampling is modeled with the ATmega2560 analogRead() time (about 110us) since there is no
+// ADC on the host.  The scanner's foreground cost per sensor value is one takeAverage() call.
+void benchmark() {
+  const double ANALOG_READ_US = 110;
+  const uint16_t sampleCnt = 20, sampleIntervalMs = 25; // ThermistorSensor before scanning
+  const uint8_t channelCnt = 8;
+
+  AnalogScanner scanner;
+  SimAdc adc;
+  for ( uint8_t ch = 0; ch < channelCnt; ch++ ) {
+    scanner.addChannel(ch);
+    adc.values[ch] = 100*ch;
+  }
+  const unsigned long conversionCnt = 10000000;
+  double isrSec = host::timeSec([&]() { adc.run(scanner, conversionCnt); });
+
+  const unsigned long takeCnt = 10000000;
+  float average, total = 0;
+  double takeSec = host::timeSec([&]() {
+    for ( unsigned long i = 0; i < takeCnt; i++ ) {
+      adc.run(scanner, 1);
+      if ( scanner.takeAverage(i % channelCnt, average) ) {
+        total += average;
+      }
+    }
+  });
+
+  double blockingUs = sampleCnt*ANALOG_READ_US + (sampleCnt-1)*sampleIntervalMs*1000.0;
+  std::printf("  scanner: %.0f conversions/s (ISR work), %.3f us per takeAverage() and conversion on host\n",
+      conversionCnt/isrSec, takeSec*1e6/takeCnt);
+  std::printf("  blocking analogRead: %.0f us foreground per value (%u samples, %u ms apart, modeled)\n",
+      blockingUs, sampleCnt, sampleIntervalMs);
+  CHECK(total > 0);
+}
+
+int main() {
+  testRoundRobin();
+  testSettleConversionsDropped();
+  testTakeSnapshotAndReset();
+  testSaturation();
+  benchmark();
+  return host::finish("AnalogScannerTest");
+}
@@ -0,0 +1,181 @@
+// BinaryFrameWriter wire format decoded byte by byte: sync, version, little endian length and records,
+// FIXED_MILLI with its FLOAT32 fallback outside +/-2e6, NAN_VALUE, BINARY_FLOAT and the Fletcher-16
+// checksum.  The byte count and checksum the writer reports for #END must cover the whole frame.  Ends
+// with the size of a GET,SENSORS poll of the sketch's 24 sensors compared with compact JSON.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/json/BinaryFrameWriter.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/sensor/Sensor.cpp"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace automation;
+using namespace automation::json;
+
+struct Frame {
+  std::string bytes;
+  unsigned long byteCnt = 0, checksum = 0;
+
+  uint8_t u8(size_t i) const { return (uint8_t) bytes[i]; }
+  uint16_t u16(size_t i) const { return u8(i) | (u8(i+1) << 8); }
+  uint32_t u32(size_t i) const { return u16(i) | ((uint32_t) u16(i+2) << 16); }
+  size_t recordAt(size_t index) const { return 4 + index * BinaryFrameWriter::RECORD_SIZE; }
+};
+
+template<typename TArray>
+Frame writeFrame(const TArray& arr, bool bFloat) {
+  StringStreamPrinter printer;
+  Frame frame;
+  {
+    BinaryFrameWriter writer(printer, bFloat);
+    writer.printFrame(arr);
+    frame.byteCnt = writer.getByteCount();
+    frame.checksum = writer.getChecksum();
+  }
+  frame.bytes = printer.ss.str();
+  return frame;
+}
+
+uint16_t fletcher16(const std::string& bytes, size_t begin, size_t end) {
+  uint16_t sum1 = 0, sum2 = 0;
+  for ( size_t i = begin; i < end; i++ ) {
+    sum1 = (sum1 + (uint8_t) bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+float decodeFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+float values[] = {26.815f, -3.25f, 0, 1999999.5f, -2500000.0f, NAN, 91.37f};
+float value0() { return values[0]; }
+float value1() { return values[1]; }
+float value2() { return values[2]; }
+float value3() { return values[3]; }
+float value4() { return values[4]; }
+float value5() { return values[5]; }
+float value6() { return values[6]; }
+
+SensorFn sensor0("Voltage", value0), sensor1("Current", value1), sensor2("Zero", value2),
+         sensor3("Large", value3), sensor4("Out of Range", value4), sensor5("Failed", value5),
+         sensor6("Temp", value6);
+Sensors sensors({&sensor0, &sensor1, &sensor2, &sensor3, &sensor4, &sensor5, &sensor6});
+
+void testLayout() {
+  CHECK(BinaryFrameWriter::RECORD_SIZE == sizeof(NumericIdentifierValue) + 5);
+  Frame frame = writeFrame(sensors, false);
+  size_t recordCnt = sensors.size();
+  size_t frameSize = 4 + recordCnt * BinaryFrameWriter::RECORD_SIZE + 2;
+  CHECK(frame.bytes.size() == frameSize);
+  CHECK(frame.u8(0) == BinaryFrameWriter::SYNC);
+  CHECK(frame.u8(1) == BinaryFrameWriter::FRAME_VERSION);
+  CHECK(frame.u16(2) == recordCnt * BinaryFrameWriter::RECORD_SIZE);
+
+  // FIXED_MILLI is little endian int32 thousandths (rounded)
+  size_t r = frame.recordAt(0);
+  CHECK(frame.u8(r) == sensor0.id);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::FIXED_MILLI);
+  CHECK(frame.u32(r+2) == 26815);
+  CHECK(frame.u8(r+2) == (26815 & 0xFF) && frame.u8(r+3) == (26815 >> 8));
+  r = frame.recordAt(1);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::FIXED_MILLI);
+  CHECK((int32_t) frame.u32(r+2) == -3250);
+  r = frame.recordAt(2);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::FIXED_MILLI && frame.u32(r+2) == 0);
+  r = frame.recordAt(3);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::FIXED_MILLI);
+  CHECK((int32_t) frame.u32(r+2) == 1999999500);
+
+  // outside +/-2e6 does not fit int32 thousandths
+  r = frame.recordAt(4);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::FLOAT32);
+  CHECK(decodeFloat(frame.u32(r+2)) == -2500000.0f);
+  r = frame.recordAt(5);
+  CHECK(frame.u8(r) == sensor5.id);
+  CHECK(frame.u8(r+1) == BinaryFrameWriter::NAN_VALUE && frame.u32(r+2) == 0);
+
+  // checksum covers FRAME_VERSION through the last record
+  CHECK(frame.u16(frameSize - 2) == fletcher16(frame.bytes, 1, frameSize - 2));
+  unsigned long sum = 0;
+  for ( char c : frame.bytes ) {
+    sum += (uint8_t) c;
+  }
+  CHECK(frame.byteCnt == frameSize);
+  CHECK(frame.checksum == sum);
+
+  // a corrupted byte is detected
+  std::string corrupted = frame.bytes;
+  corrupted[frame.recordAt(0) + 2] ^= 0x10;
+  CHECK(fletcher16(corrupted, 1, frameSize - 2) != frame.u16(frameSize - 2));
+}
+
+void testFloatFormat() {
+  Frame frame = writeFrame(sensors, true);
+  for ( size_t i = 0; i < sensors.size(); i++ ) {
+    size_t r = frame.recordAt(i);
+    CHECK(frame.u8(r) == sensors[i]->id);
+    if ( std::isnan(values[i]) ) {
+      CHECK(frame.u8(r+1) == BinaryFrameWriter::NAN_VALUE);
+    } else {
+      CHECK(frame.u8(r+1) == BinaryFrameWriter::FLOAT32);
+      CHECK(decodeFloat(frame.u32(r+2)) == values[i]);
+    }
+  }
+  CHECK(frame.u16(frame.bytes.size() - 2) == fletcher16(frame.bytes, 1, frame.bytes.size() - 2));
+}
+
+// Sensor names and typical values of the sketch's GET,SENSORS poll
+const char* sketchNames[] = {
+  "Chargers Temp", "Battery Bank Voltage", "Bank Current", "Battery Bank Power",
+  "Bank Charge Ah", "Bank Discharge Ah", "Bank Charge Wh", "Bank Discharge Wh",
+  "Bank A Voltage", "Bank B Voltage", "Enclosure Temp", "Inverter and Enclosure Temp",
+  "Enclosure Temp (DHT)", "Enclosure Humidity", "Charger 1 Temp", "Charger 2 Temp",
+  "Inverter Temp", "Inverter Group Temp", "Enclosure Fan", "Chargers Fan",
+  "Inverter Fan", "Inverter Power", "Outlet 1", "Outlet 2"};
+float sketchValue() { return 91.37f; }
+
+void testPollSize() {
+  Sensors sketchSensors;
+  for ( const char* name : sketchNames ) {
+    sketchSensors.push_back(new SensorFn(name, sketchValue));
+  }
+  sketchSensors.getValuesBySampling();
+
+  json::jsonFormat = JsonFormat::COMPACT;
+  StringStreamPrinter printer;
+  unsigned long jsonCnt;
+  {
+    // same body as the GET,SENSORS response in loop()
+    JsonStreamWriter w(printer);
+    w.println("[");
+    w.println("{");
+    w.printlnVectorObj(F("sensors"), sketchSensors, ",");
+    w.printlnStringObj(F("respMsg"), "OK", ",");
+    w.printlnNumberObj(F("respCode"), 0);
+    w.println("}");
+    w.print("]");
+    jsonCnt = w.getByteCount();
+  }
+  Frame frame = writeFrame(sketchSensors, false);
+  CHECK(sketchSensors.size() == 24);
+  CHECK(frame.bytes.size() == 150);
+  CHECK(jsonCnt >= 5 * frame.bytes.size());
+  std::printf("  24 sensor poll: compact JSON %lu bytes, binary frame %lu bytes (%.1fx smaller)\n",
+      jsonCnt, (unsigned long) frame.bytes.size(), (double) jsonCnt / frame.bytes.size());
+}
+
+int main() {
+  sensors.getValuesBySampling();
+  testLayout();
+  testFloatFormat();
+  testPollSize();
+  return host::finish("BinaryFrameWriterTest");
+}
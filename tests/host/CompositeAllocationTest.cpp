@@ -0,0 +1,107 @@
+// Steady state constraint evaluation must not touch the heap (8KB RAM board).  Global operator new is
+// replaced with a counting version and AND/OR trees (short circuit, adaptive order, NOT, schedules,
+// deferrals, synchronizing passes, compiled plans and the event journal) are evaluated for many passes.
+
+#include "HostTest.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace heap {
+  bool bCounting = false;
+  unsigned long allocationCnt = 0;
+
+  // Every replaced delete frees here.  Not inlined so -Wmismatched-new-delete does not see free() on
+  // the result of operator new (the replaced new does allocate with malloc).
+  __attribute__((noinline)) void release(void* p) noexcept {
+    std::free(p);
+  }
+}
+
+void* operator new(std::size_t size) {
+  if ( heap::bCounting ) {
+    heap::allocationCnt++;
+  }
+  void* p = std::malloc(size ? size : 1);
+  if ( !p ) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { heap::release(p); }
+void operator delete[](void* p) noexcept { heap::release(p); }
+void operator delete(void* p, std::size_t) noexcept { heap::release(p); }
+void operator delete[](void* p, std::size_t) noexcept { heap::release(p); }
+
+#include "automation/Automation.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/constraint/Constraint.h"
+#include "automation/constraint/NotConstraint.h"
+#include "automation/constraint/ValueConstraint.h"
+#include "automation/constraint/AndConstraint.h"
+#include "automation/constraint/OrConstraint.h"
+#include "automation/constraint/TimeRangeConstraint.h"
+#include "automation/constraint/ScheduledConstraint.h"
+#include "automation/constraint/ConstraintEventJournal.h"
+#include "automation/constraint/ConstraintPlan.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+using namespace automation;
+
+float values[4];
+float getValue0() { return values[0]; }
+float getValue1() { return values[1]; }
+float getValue2() { return values[2]; }
+float getValue3() { return values[3]; }
+
+int main() {
+  ConstraintEventJournal::instance();
+  SensorFn sensor0("a",getValue0), sensor1("b",getValue1), sensor2("c",getValue2), sensor3("d",getValue3);
+  SensorFn* sensors[] = { &sensor0, &sensor1, &sensor2, &sensor3 };
+
+  std::vector<Constraint*> leaves;
+  for ( int i = 0; i < 8; i++ ) {
+    AtLeast<float,Sensor&>* pLeaf = new AtLeast<float,Sensor&>(50, *sensors[i%4]);
+    pLeaf->setPassDelayMs((i%3)*1000).setFailDelayMs((i%2)*2000);
+    leaves.push_back(pLeaf);
+  }
+  AndConstraint* pShortCircuitAnd = new AndConstraint({leaves[0], leaves[1], leaves[2]});
+  pShortCircuitAnd->setShortCircuit(true);
+  pShortCircuitAnd->setAdaptiveOrder(true);
+  OrConstraint* pShortCircuitOr = new OrConstraint({leaves[3], new NotConstraint(leaves[4]), leaves[5]});
+  pShortCircuitOr->setShortCircuit(true);
+  OrConstraint* pOr = new OrConstraint({leaves[6], leaves[7], new SlopeConstraint<float,Sensor&>(1, sensor0)});
+  ScheduledConstraint* pSchedule = new ScheduledConstraint();
+  pSchedule->hours = {{6,18}};
+  AndConstraint* pRoot = new AndConstraint({pShortCircuitAnd, pShortCircuitOr, new NotConstraint(pOr),
+      new TimeRangeConstraint({6,0,0},{18,0,0}), pSchedule});
+  OrConstraint* pRoot2 = new OrConstraint({pShortCircuitAnd, pOr});
+  ConstraintPlan plan(pRoot);
+
+  const int warmupCnt = 2000, passCnt = 40000;
+  srand(4);
+  for ( int pass = 0; pass < warmupCnt + passCnt; pass++ ) {
+    heap::bCounting = pass >= warmupCnt; // first passes fill vectors that are sized once (order, trend samples)
+    host::nowMs += 250;
+    for ( int i = 0; i < 4; i++ ) {
+      values[i] = rand() % 100;
+    }
+    automation::bSynchronizing = (pass % 100) == 0;
+    Sensor::invalidateAll();
+    TimerWheel::instance().advance(host::nowMs);
+    Constraints::beginEvaluation();
+    plan.run();
+    pRoot2->test();
+    Constraints::endEvaluation();
+    pRoot->test(); // outside an evaluation pass like command handlers
+    pShortCircuitOr->test();
+  }
+  heap::bCounting = false;
+  automation::bSynchronizing = false;
+
+  std::printf("  %d passes: %lu allocations\n", passCnt, heap::allocationCnt);
+  CHECK(heap::allocationCnt == 0);
+  return host::finish("CompositeAllocationTest");
+}
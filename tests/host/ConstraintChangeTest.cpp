@@ -0,0 +1,98 @@
+// Constraints on sensors published by Sensors are only tested again when an epoch changes their value.
+// Composites are marked by their changed children (shared children mark every parent) and only ask
+// polled children (sensors without epochs) whether their inputs changed.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/constraint/Constraint.h"
+#include "automation/constraint/ValueConstraint.h"
+#include "automation/constraint/AndConstraint.h"
+#include "automation/constraint/OrConstraint.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+using namespace automation;
+
+struct ValueSensor : public Sensor {
+  RTTI_GET_TYPE_IMPL(test,ValueSensor)
+  float value;
+  ValueSensor(const char* name, float value) : Sensor(name), value(value) {}
+  float getValueImpl() const override { return value; }
+};
+
+struct CountedMin : public AtLeast<float,Sensor&> {
+  int checkCnt = 0, askCnt = 0;
+  CountedMin(float threshold, Sensor& sensor) : AtLeast<float,Sensor&>(threshold, sensor) {}
+
+  bool checkValue(const float& value) override {
+    checkCnt++;
+    return AtLeast<float,Sensor&>::checkValue(value);
+  }
+
+  bool isInputChanged() override {
+    askCnt++;
+    return AtLeast<float,Sensor&>::isInputChanged();
+  }
+};
+
+float liveValue = 60;
+float getLiveValue() { return liveValue; }
+
+void testNotified() {
+  ValueSensor voltage("Voltage", 60), temp("Temp", 60);
+  Sensors sensors({&voltage, &temp});
+  CountedMin minVoltage(50, voltage), minTemp(50, temp);
+  AndConstraint both({&minVoltage, &minTemp});
+  OrConstraint either({&minVoltage});
+
+  sensors.getValuesBySampling();
+  CHECK(both.test() && either.test());
+  CHECK(minVoltage.checkCnt == 1 && minTemp.checkCnt == 1);
+
+  // nothing published so nothing is asked
+  minVoltage.askCnt = minTemp.askCnt = 0;
+  for ( int i = 0; i < 10; i++ ) {
+    CHECK(both.test() && either.test());
+  }
+  CHECK(minVoltage.checkCnt == 1 && minTemp.checkCnt == 1);
+  CHECK(minVoltage.askCnt == 0 && minTemp.askCnt == 0);
+
+  // same values published
+  sensors.getValuesBySampling();
+  CHECK(both.test());
+  CHECK(minVoltage.checkCnt == 1 && minTemp.checkCnt == 1);
+
+  // new voltage marks both parents of the shared constraint
+  voltage.value = 40;
+  sensors.getValuesBySampling();
+  CHECK(!both.test());
+  CHECK(minVoltage.checkCnt == 2 && minTemp.checkCnt == 1);
+  CHECK(!either.test());
+  CHECK(minVoltage.checkCnt == 2);
+}
+
+void testPolled() {
+  ValueSensor voltage("Voltage", 60);
+  SensorFn live("Live", getLiveValue); // not cacheable and not in Sensors
+  Sensors sensors({&voltage});
+  CountedMin minVoltage(50, voltage), minLive(50, live);
+  AndConstraint both({&minVoltage, &minLive});
+
+  sensors.getValuesBySampling();
+  CHECK(both.test());
+  minVoltage.askCnt = minLive.askCnt = 0;
+  CHECK(both.test());
+  CHECK(minLive.askCnt == 1 && minVoltage.askCnt == 0);
+  CHECK(minLive.checkCnt == 1);
+
+  liveValue = 40;
+  CHECK(!both.test());
+  CHECK(minLive.checkCnt == 2 && minVoltage.checkCnt == 1);
+}
+
+int main() {
+  testNotified();
+  testPolled();
+  return host::finish("ConstraintChangeTest");
+}
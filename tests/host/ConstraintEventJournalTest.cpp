@@ -0,0 +1,127 @@
+// ConstraintEventJournal::print() after more events than CAPACITY: the events after sinceSeq that are still
+// in the ring are printed in order, droppedCnt counts the overwritten ones, and a sinceSeq past lastSeq
+// (client from before a restart) starts over from 0.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/json/JsonStreamWriter.h"
+#include "automation/constraint/Constraint.h"
+#include "automation/constraint/BooleanConstraint.h"
+#include "automation/constraint/ConstraintEventJournal.h"
+#include "automation/constraint/Constraint.cpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace automation;
+using namespace automation::json;
+
+struct Printed {
+  unsigned long lastSeq = 0, droppedCnt = 0;
+  std::vector<unsigned long> seqs, durations;
+};
+
+// Number after "key": at or after pos (npos when missing)
+unsigned long numberAfter(const std::string& str, const char* key, size_t& pos) {
+  std::string quoted = std::string("\"") + key + "\"";
+  pos = str.find(quoted, pos);
+  if ( pos == std::string::npos ) {
+    return 0;
+  }
+  pos = str.find(':', pos) + 1;
+  return strtoul(str.c_str() + pos, nullptr, 10);
+}
+
+Printed print(uint32_t sinceSeq) {
+  StringStreamPrinter printer;
+  {
+    JsonStreamWriter w(printer);
+    ConstraintEventJournal::instance().print(w, sinceSeq);
+  }
+  std::string str = printer.ss.str();
+  Printed printed;
+  size_t pos = 0;
+  printed.lastSeq = numberAfter(str, "lastSeq", pos);
+  printed.droppedCnt = numberAfter(str, "droppedCnt", pos);
+  while ( true ) {
+    unsigned long seq = numberAfter(str, "seq", pos);
+    if ( pos == std::string::npos ) {
+      break;
+    }
+    printed.seqs.push_back(seq);
+    printed.durations.push_back(numberAfter(str, "durationMs", pos));
+  }
+  return printed;
+}
+
+// Events seq first to last in order with the duration each was added with
+bool hasEvents(const Printed& printed, unsigned long first, unsigned long last) {
+  if ( printed.seqs.size() != (first <= last ? last - first + 1 : 0) ) {
+    return false;
+  }
+  for ( size_t i = 0; i < printed.seqs.size(); i++ ) {
+    if ( printed.seqs[i] != first + i || printed.durations[i] != (first + i) * 100 ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BooleanConstraint constraint(true);
+
+void addEvents(unsigned long cnt) {
+  ConstraintEventJournal& journal = ConstraintEventJournal::instance();
+  for ( unsigned long i = 0; i < cnt; i++ ) {
+    unsigned long seq = journal.getLastSeq() + 1;
+    journal.resultChanged(&constraint, seq % 2, seq * 100); // duration identifies the event
+  }
+}
+
+void testPartial() {
+  addEvents(10);
+  Printed printed = print(0);
+  CHECK(printed.lastSeq == 10 && printed.droppedCnt == 0);
+  CHECK(hasEvents(printed, 1, 10));
+  printed = print(4);
+  CHECK(printed.droppedCnt == 0 && hasEvents(printed, 5, 10));
+}
+
+void testWrapped() {
+  const unsigned long cap = ConstraintEventJournal::CAPACITY;
+  addEvents(cap + 6 - 10); // 30 events, 1 to 6 overwritten
+  ConstraintEventJournal& journal = ConstraintEventJournal::instance();
+  CHECK(journal.getLastSeq() == cap + 6 && journal.getFirstSeq() == 7);
+
+  Printed printed = print(0);
+  CHECK(printed.lastSeq == cap + 6);
+  CHECK(printed.droppedCnt == 6 && hasEvents(printed, 7, cap + 6));
+  printed = print(5);
+  CHECK(printed.droppedCnt == 1 && hasEvents(printed, 7, cap + 6));
+  printed = print(6);
+  CHECK(printed.droppedCnt == 0 && hasEvents(printed, 7, cap + 6));
+  printed = print(20);
+  CHECK(printed.droppedCnt == 0 && hasEvents(printed, 21, cap + 6));
+  printed = print(cap + 6);
+  CHECK(printed.droppedCnt == 0 && printed.seqs.empty());
+
+  // sequence numbers from before a restart start over
+  printed = print(cap + 100);
+  CHECK(printed.lastSeq == cap + 6);
+  CHECK(printed.droppedCnt == 6 && hasEvents(printed, 7, cap + 6));
+
+  // several more wraps
+  addEvents(3 * cap + 5);
+  unsigned long lastSeq = journal.getLastSeq();
+  printed = print(lastSeq - 3);
+  CHECK(printed.droppedCnt == 0 && hasEvents(printed, lastSeq - 2, lastSeq));
+  printed = print(lastSeq - cap - 2);
+  CHECK(printed.droppedCnt == 2 && hasEvents(printed, lastSeq - cap + 1, lastSeq));
+}
+
+int main() {
+  testPartial();
+  testWrapped();
+  return host::finish("ConstraintEventJournalTest");
+}
@@ -0,0 +1,260 @@
+// ConstraintPlan must give the same results as the recursive test() path.  Two identical copies of the
+// sketch's device trees (fans, outlets sharing voltage constraints) plus a deeper AND/OR/NOT tree see
+// the same sensor values, mode changes and remote results.  One copy is tested recursively and the
+// other through compiled plans.  GET,STATS call counts must match too.  Adaptive order turned on after
+// compiling must recompile the plan.  Ends with a benchmark of both paths.
+
+#define AUTOMATION_PROFILING
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/constraint/Constraint.h"
+#include "automation/constraint/NotConstraint.h"
+#include "automation/constraint/ValueConstraint.h"
+#include "automation/constraint/AndConstraint.h"
+#include "automation/constraint/OrConstraint.h"
+#include "automation/constraint/ConstraintPlan.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+#include <cstdlib>
+
+using namespace automation;
+
+float enclosureTemp = 90, inverterTemp = 90, bankVoltage = 24, bankCurrent = 0;
+float getEnclosureTemp() { return enclosureTemp; }
+float getInverterTemp() { return inverterTemp; }
+float getBankVoltage() { return bankVoltage; }
+float getBankCurrent() { return bankCurrent; }
+
+SensorFn enclosureTempSensor("Enclosure Temp", getEnclosureTemp),
+         inverterTempSensor("Inverter Temp", getInverterTemp),
+         bankVoltageSensor("Battery Bank Voltage", getBankVoltage),
+         bankCurrentSensor("Bank Current", getBankCurrent);
+
+typedef AtLeast<float,Sensor&> MinValue;
+
+struct DeviceTrees {
+  std::vector<Constraint*> roots;
+  std::vector<Constraint*> constraints; // every node, same order in each copy
+
+  template<typename T>
+  T* add(T* pConstraint) {
+    constraints.push_back(pConstraint);
+    return pConstraint;
+  }
+
+  DeviceTrees() {
+    // cooling fans (arduino-solar-sketch.ino thresholds)
+    MinValue* pEnclosureFan = add(new MinValue(98, enclosureTempSensor));
+    pEnclosureFan->setFailMargin(3);
+    MinValue* pInverterFan = add(new MinValue(103, inverterTempSensor));
+    pInverterFan->setFailMargin(3).setFailDelayMs(60*SECONDS);
+
+    // outlets share the steady and dip supply voltage constraints
+    MinValue* pSteady = add(new MinValue(23, bankVoltageSensor));
+    pSteady->setPassDelayMs(15ul*MINUTES).setFailDelayMs(1*MINUTES).setPassMargin(2);
+    MinValue* pDip = add(new MinValue(21.5, bankVoltageSensor));
+    pDip->setPassDelayMs(5ul*MINUTES).setFailDelayMs(5*SECONDS).setPassMargin(2);
+    AndConstraint* pOutlet1 = add(new AndConstraint({pSteady, pDip}));
+    AndConstraint* pOutlet2 = add(new AndConstraint({pSteady, pDip}));
+
+    // deeper tree with short circuits, NOT and a delayed composite
+    MinValue* pCharging = add(new MinValue(5, bankCurrentSensor));
+    pCharging->setPassDelayMs(30*SECONDS);
+    MinValue* pHot = add(new MinValue(110, inverterTempSensor));
+    NotConstraint* pNotHot = add(new NotConstraint(pHot));
+    AndConstraint* pSafe = add(new AndConstraint({pNotHot, pSteady, pCharging}));
+    pSafe->setShortCircuit(true);
+    OrConstraint* pEither = add(new OrConstraint({pSafe, pEnclosureFan, add(new NotConstraint(pDip))}));
+    pEither->setShortCircuit(true);
+    pEither->setPassDelayMs(10*SECONDS).setFailDelayMs(20*SECONDS);
+    AndConstraint* pInverter = add(new AndConstraint({pEither, add(new NotConstraint(pInverterFan))}));
+
+    roots = { pEnclosureFan, pInverterFan, pOutlet1, pOutlet2, pInverter };
+  }
+};
+
+bool sameState(DeviceTrees& recursive, DeviceTrees& compiled) {
+  for ( size_t i = 0; i < recursive.constraints.size(); i++ ) {
+    Constraint* pR = recursive.constraints[i];
+    Constraint* pC = compiled.constraints[i];
+    if ( pR->isPassed() != pC->isPassed() || pR->isDeferred() != pC->isDeferred() ) {
+      std::printf("  constraint %u differs: passed %d/%d deferred %d/%d\n", (unsigned) i,
+          pR->isPassed(), pC->isPassed(), pR->isDeferred(), pC->isDeferred());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Same command applied to the same constraint of both copies
+void setAttribute(DeviceTrees& recursive, DeviceTrees& compiled, size_t index, const char* pszKey, const char* pszVal) {
+  recursive.constraints[index]->setAttribute(pszKey, pszVal);
+  compiled.constraints[index]->setAttribute(pszKey, pszVal);
+}
+
+void testSameResults() {
+  DeviceTrees recursive, compiled;
+  std::vector<ConstraintPlan*> plans;
+  for ( Constraint* pRoot : compiled.roots ) {
+    plans.push_back(new ConstraintPlan(pRoot));
+    CHECK(plans.back()->isValid());
+  }
+
+  static const char* modes[] = { "TEST", "PASS", "FAIL", "REMOTE_OR_TEST", "REMOTE_OR_PASS", "REMOTE_OR_FAIL" };
+  srand(17);
+  unsigned long resultDiffCnt = 0, stateDiffCnt = 0, changeCnt = 0, deferredCnt = 0;
+  bool bLastInverter = false;
+  for ( int step = 0; step < 200000; step++ ) {
+    host::nowMs += 250 + rand() % 1000;
+    enclosureTemp += (rand() % 201 - 100) / 100.0;
+    inverterTemp += (rand() % 201 - 100) / 100.0;
+    bankVoltage += (rand() % 201 - 100) / 500.0;
+    bankCurrent = rand() % 30 - 10;
+    enclosureTemp = enclosureTemp < 80 ? 80 : enclosureTemp > 120 ? 120 : enclosureTemp;
+    inverterTemp = inverterTemp < 80 ? 80 : inverterTemp > 120 ? 120 : inverterTemp;
+    bankVoltage = bankVoltage < 20 ? 20 : bankVoltage > 27 ? 27 : bankVoltage;
+
+    if ( step % 997 == 0 ) {
+      size_t index = rand() % recursive.constraints.size();
+      setAttribute(recursive, compiled, index, "mode", modes[rand() % 6]);
+    }
+    if ( step % 331 == 0 ) {
+      size_t index = rand() % recursive.constraints.size();
+      setAttribute(recursive, compiled, index, "passed", rand() % 2 ? "TRUE" : "FALSE");
+    }
+    if ( step % 50000 == 25000 ) {
+      automation::client::watchdog::messageReceived(); // remote results expire again later
+    }
+
+    Sensor::invalidateAll();
+    TimerWheel::instance().advance(host::nowMs);
+
+    std::vector<bool> expected;
+    Constraints::beginEvaluation();
+    for ( Constraint* pRoot : recursive.roots ) {
+      expected.push_back(pRoot->test());
+    }
+    Constraints::endEvaluation();
+
+    Constraints::beginEvaluation();
+    for ( size_t i = 0; i < plans.size(); i++ ) {
+      if ( plans[i]->run() != expected[i] ) {
+        resultDiffCnt++;
+      }
+    }
+    Constraints::endEvaluation();
+
+    if ( !sameState(recursive, compiled) ) {
+      stateDiffCnt++;
+    }
+    if ( expected.back() != bLastInverter ) {
+      changeCnt++;
+      bLastInverter = expected.back();
+    }
+    for ( Constraint* pConstraint : recursive.constraints ) {
+      deferredCnt += pConstraint->isDeferred();
+    }
+  }
+  unsigned long profileDiffCnt = 0;
+  for ( size_t i = 0; i < recursive.constraints.size(); i++ ) {
+    if ( recursive.constraints[i]->testProfile.callCnt != compiled.constraints[i]->testProfile.callCnt ) {
+      profileDiffCnt++;
+    }
+  }
+  CHECK(resultDiffCnt == 0);
+  CHECK(stateDiffCnt == 0);
+  CHECK(profileDiffCnt == 0);
+  CHECK(compiled.roots.back()->testProfile.callCnt > 0); // composite evaluated by the plan is counted
+  CHECK(changeCnt > 10); // inputs actually exercised both results
+  CHECK(deferredCnt > 1000); // and deferrals
+  std::printf("  200000 passes: %lu result and %lu state differences, %lu inverter changes\n",
+      resultDiffCnt, stateDiffCnt, changeCnt);
+  for ( ConstraintPlan* pPlan : plans ) {
+    delete pPlan;
+  }
+}
+
+// Without children AND and OR pass on both paths
+void testEmptyComposites() {
+  AndConstraint emptyAnd({});
+  OrConstraint emptyOr({});
+  ConstraintPlan andPlan(&emptyAnd), orPlan(&emptyOr);
+  CHECK(andPlan.isValid() && orPlan.isValid());
+  CHECK(andPlan.run() && orPlan.run());
+  CHECK(emptyAnd.test() && emptyOr.test());
+}
+
+float passValue = 10, failValue = 0;
+float getPassValue() { return passValue; }
+float getFailValue() { return failValue; }
+
+// Turning adaptive order on after compiling recompiles the plan so the order and child stats follow
+// the evaluations made through it
+void testAdaptiveOrder() {
+  SensorFn passSensor("Pass", getPassValue), failSensor("Fail", getFailValue);
+  MinValue alwaysPass(0, passSensor), alwaysFail(5, failSensor);
+  AndConstraint both({&alwaysPass, &alwaysFail});
+  both.setShortCircuit(true);
+  ConstraintPlan plan(&both);
+  size_t inlineSize = plan.size();
+
+  both.setAdaptiveOrder(true);
+  for ( int i = 0; i < 2 * CompositeConstraint::ORDER_UPDATE_INTERVAL; i++ ) {
+    host::nowMs += 250;
+    passValue = 10 + i % 2; // inputs change so every pass tests the children
+    failValue = i % 2;
+    Constraints::beginEvaluation();
+    CHECK(!plan.run());
+    Constraints::endEvaluation();
+  }
+  CHECK(plan.size() < inlineSize); // single node
+  CHECK(both.getChildStats(0).testCnt > 0 && both.getChildStats(1).decisiveCnt > 0);
+  CHECK(*CompositeConstraint::ChildIterator(both) == &alwaysFail); // decisive child moved first
+
+  both.setAdaptiveOrder(false);
+  CHECK(!plan.run());
+  CHECK(plan.size() == inlineSize);
+  CHECK(*CompositeConstraint::ChildIterator(both) == &alwaysPass);
+}
+
+void benchmark() {
+  DeviceTrees recursive, compiled;
+  ConstraintPlan plan(compiled.roots.back());
+  Constraint* pRoot = recursive.roots.back();
+  const unsigned long cnt = 2000000;
+  unsigned long passedCnt = 0;
+
+  double recursiveSec = host::timeSec([&]() {
+    for ( unsigned long i = 0; i < cnt; i++ ) {
+      host::nowMs += 250;
+      bankCurrent = i % 30;
+      Sensor::invalidateAll();
+      Constraints::beginEvaluation();
+      passedCnt += pRoot->test();
+      Constraints::endEvaluation();
+    }
+  });
+  double planSec = host::timeSec([&]() {
+    for ( unsigned long i = 0; i < cnt; i++ ) {
+      host::nowMs += 250;
+      bankCurrent = i % 30;
+      Sensor::invalidateAll();
+      Constraints::beginEvaluation();
+      passedCnt += plan.run();
+      Constraints::endEvaluation();
+    }
+  });
+  std::printf("  inverter tree (%u instructions): recursive %.0f evaluations/s, plan %.0f evaluations/s (%lu passed)\n",
+      (unsigned) plan.size(), cnt/recursiveSec, cnt/planSec, passedCnt);
+}
+
+int main() {
+  testSameResults();
+  testEmptyComposites();
+  testAdaptiveOrder();
+  benchmark();
+  return host::finish("ConstraintPlanTest");
+}
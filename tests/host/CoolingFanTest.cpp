@@ -0,0 +1,109 @@
+// Predictive CoolingFan on a temperature ramping 0.3 degrees per minute (15 second epochs like the
+// sketch).  The predictive fan must start about one horizon (5 minutes) before a reactive fan on the
+// same sensor and count the start as predicted with that lead time.  A ramp that reverses before
+// reaching the on temp must count a predicted miss and never start the reactive fan.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/json/JsonStreamWriter.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/constraint/ValueConstraint.h"
+using namespace automation::json;
+#include "automation/device/CoolingFan.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/device/Device.cpp"
+#include "automation/capability/Capability.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+using namespace automation;
+
+struct TempSensor : public Sensor {
+  RTTI_GET_TYPE_IMPL(test,TempSensor)
+  float temp = 90;
+  TempSensor() : Sensor("Enclosure Temp") {}
+  float getValueImpl() const override { return temp; }
+};
+
+struct Fan : public CoolingFan {
+  RTTI_GET_TYPE_IMPL(test,Fan)
+  bool bOn = false;
+  unsigned long onMs = 0;
+  Fan(const char* name, Sensor& sensor) : CoolingFan(name, sensor, 98, 95) {}
+  bool isOn() const override { return bOn; }
+  void setOn(bool bOn) override {
+    if ( bOn && !this->bOn ) {
+      onMs = host::nowMs;
+    }
+    this->bOn = bOn;
+  }
+  void setup() override {}
+};
+
+const unsigned long EPOCH_MS = 15*SECONDS;
+const float RAMP_PER_EPOCH = 0.3f * EPOCH_MS / MINUTES;
+
+TempSensor tempSensor;
+Sensors sensors({&tempSensor});
+Fan predictive("Predictive Fan", tempSensor), reactive("Reactive Fan", tempSensor);
+
+// One sketch loop() pass that samples
+void epoch(float ramp) {
+  host::nowMs += EPOCH_MS;
+  tempSensor.temp += ramp;
+  sensors.getValuesBySampling();
+  Constraints::beginEvaluation();
+  predictive.applyConstraint();
+  reactive.applyConstraint();
+  Constraints::endEvaluation();
+}
+
+void testRamp() {
+  for ( int i = 0; i < 200 && !reactive.isOn(); i++ ) {
+    epoch(RAMP_PER_EPOCH);
+  }
+  CHECK(predictive.isOn() && reactive.isOn());
+  unsigned long leadMs = reactive.onMs - predictive.onMs;
+  CHECK(leadMs >= 4*MINUTES + 30*SECONDS && leadMs <= 5*MINUTES + 15*SECONDS);
+
+  const CoolingFan::ActivationStats& stats = predictive.getActivationStats();
+  CHECK(stats.predictedCnt == 1 && stats.reactiveCnt == 0);
+  CHECK(stats.leadCnt == 1 && stats.lastLeadMs == leadMs);
+  CHECK(reactive.getActivationStats().reactiveCnt == 1 && reactive.getActivationStats().predictedCnt == 0);
+  std::printf("  0.3/min ramp: predictive start %lus before reactive start at %.2f, lead %lus\n",
+      leadMs / 1000, tempSensor.temp, stats.lastLeadMs / 1000);
+
+  // cool down below the off temp
+  for ( int i = 0; i < 200 && (predictive.isOn() || reactive.isOn()); i++ ) {
+    epoch(-RAMP_PER_EPOCH);
+  }
+  CHECK(!predictive.isOn() && !reactive.isOn());
+  CHECK(stats.predictedMissCnt == 0);
+}
+
+void testReversal() {
+  while ( tempSensor.temp > 90 ) {
+    epoch(-RAMP_PER_EPOCH);
+  }
+  for ( int i = 0; i < 200 && !predictive.isOn(); i++ ) {
+    epoch(RAMP_PER_EPOCH);
+  }
+  CHECK(predictive.isOn() && !reactive.isOn());
+  CHECK(tempSensor.temp < predictive.getOnTemp());
+
+  // trend reverses before the on temp is reached
+  for ( int i = 0; i < 200 && predictive.isOn(); i++ ) {
+    epoch(-RAMP_PER_EPOCH);
+  }
+  const CoolingFan::ActivationStats& stats = predictive.getActivationStats();
+  CHECK(!predictive.isOn());
+  CHECK(stats.predictedCnt == 2 && stats.predictedMissCnt == 1 && stats.leadCnt == 1);
+  CHECK(reactive.getActivationStats().reactiveCnt == 1); // never reached the on temp
+}
+
+int main() {
+  predictive.setPredictive(true);
+  sensors.getValuesBySampling();
+  testRamp();
+  testReversal();
+  return host::finish("CoolingFanTest");
+}
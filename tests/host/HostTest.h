@@ -0,0 +1,49 @@
+#ifndef AUTOMATION_TESTS_HOST_TEST_H
+#define AUTOMATION_TESTS_HOST_TEST_H
+
+// Host (Linux) support for the tests in this directory.  A simulated clock replaces millis() so deferrals
+// and timers are deterministic, and CHECK() counts failures for the exit code.  Each test is one
+// translation unit like the sketch: include this first, then the automation headers and .cpp files.
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+
+namespace automation {
+
+  namespace host {
+    unsigned long nowMs = 1000;
+    int failCnt = 0;
+  }
+
+  unsigned long millisecs() { return host::nowMs; }
+  unsigned long microsecs() { return host::nowMs*1000; }
+  void sleep(unsigned long intervalMs) { host::nowMs += intervalMs; }
+  std::ostream& getLogBufferImpl() { return std::cerr; }
+  void clearLogBuffer() {}
+  void logBufferToString(std::string& strDest) {}
+  bool isTimeValid() { return true; }
+  void threadKeepAliveReset() {}
+
+  namespace host {
+
+    // Wall clock seconds for benchmarks (millisecs() is simulated)
+    template<typename Fn>
+    double timeSec(Fn fn) {
+      auto begin = std::chrono::steady_clock::now();
+      fn();
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    int finish(const char* pszTest) {
+      std::printf("%s: %s\n", pszTest, failCnt ? "FAILED" : "OK");
+      return failCnt ? 1 : 0;
+    }
+  }
+}
+
+#define CHECK(cond) do { if ( !(cond) ) { \
+    std::printf("%s:%d CHECK(%s) failed\n", __FILE__, __LINE__, #cond); automation::host::failCnt++; } } while(0)
+
+#endif
@@ -0,0 +1,266 @@
+// JsonStreamWriter output must match the bytes the writer sent before staging was added: every token
+// formatted with ostream <<.  A verbose devices response is compared with data/devices-verbose.json,
+// captured from that writer (build against the older tree and run with --write-golden to capture again).
+// Byte count and checksum must describe exactly the bytes sent (the older writer counted Arduino Print
+// formatting instead, and nothing on the host).  Ends with a bytes per second benchmark of the staged
+// writer and of the older two-pass formatting (count pass, then a second print to the stream).
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/json/JsonStreamWriter.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/constraint/ValueConstraint.h"
+#include "automation/constraint/AndConstraint.h"
+#include "automation/constraint/NotConstraint.h"
+using namespace automation::json;
+#include "automation/device/CoolingFan.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/device/Device.cpp"
+#include "automation/capability/Capability.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace automation;
+
+const char* GOLDEN_PATH = "data/devices-verbose.json";
+
+unsigned long sumBytes(const std::string& str) {
+  unsigned long sum = 0;
+  for ( char c : str ) {
+    sum += (uint8_t) c;
+  }
+  return sum;
+}
+
+void testTokens() {
+  StringStreamPrinter printer;
+  std::ostringstream expected;
+  unsigned long byteCnt, checksum;
+  {
+    JsonStreamWriter w(printer);
+    std::string str("std::string");
+    char szMutable[] = "char*";
+    w.noPrefixPrint(0).noPrefixPrint(-42).noPrefixPrint(4000000000ul).noPrefixPrint((unsigned char) 7);
+    expected << 0 << -42 << 4000000000ul << (unsigned char) 7;
+    w.noPrefixPrint(91.37f).noPrefixPrint(1e-7f).noPrefixPrint(12345678.9f).noPrefixPrint(-0.5).noPrefixPrint(NAN);
+    expected << 91.37f << 1e-7f << 12345678.9f << -0.5 << NAN;
+    w.noPrefixPrint(true).noPrefixPrint('x').noPrefixPrint(str).noPrefixPrint(szMutable).noPrefixPrint(F("flash"));
+    expected << true << 'x' << str << szMutable << F("flash");
+    // longer than the staging buffer
+    std::string longStr(200, 'z');
+    w.noPrefixPrint(longStr.c_str());
+    expected << longStr;
+    byteCnt = w.getByteCount();
+    checksum = w.getChecksum();
+  }
+  CHECK(printer.ss.str() == expected.str());
+  CHECK(byteCnt == expected.str().size());
+  CHECK(checksum == sumBytes(expected.str()));
+}
+
+// Writers share one formatting stream so interleaved writers must not mix output
+void testInterleavedWriters() {
+  StringStreamPrinter printerA, printerB;
+  {
+    JsonStreamWriter a(printerA), b(printerB);
+    a.noPrefixPrint(1.5f);
+    b.noPrefixPrint(2.25f);
+    a.noPrefixPrint(",");
+    b.noPrefixPrint(",");
+    a.noPrefixPrint(3);
+    b.noPrefixPrint(4);
+  }
+  CHECK(printerA.ss.str() == "1.5,3");
+  CHECK(printerB.ss.str() == "2.25,4");
+}
+
+// implPrint() output bypasses the count but must stay in order with staged bytes
+void testImplPrintOrder() {
+  StringStreamPrinter printer;
+  unsigned long byteCnt;
+  {
+    JsonStreamWriter w(printer);
+    w.implPrint("#BEGIN#");
+    w.noPrefixPrint("[").noPrefixPrint(1.5f).noPrefixPrint("]");
+    w.implPrint("#END:");
+    byteCnt = w.getByteCount();
+    w.implPrint(byteCnt);
+  }
+  CHECK(printer.ss.str() == "#BEGIN#[1.5]#END:5");
+}
+
+float enclosureTemp() { return 91.37f; }
+float inverterTemp() { return 104.2f; }
+float bankVoltage() { return 26.81f; }
+
+struct Fan : CoolingFan {
+  bool bOn = false;
+  RTTI_GET_TYPE_IMPL(test,Fan)
+  Fan(const char* name, Sensor& sensor, float onTemp, float offTemp) : CoolingFan(name, sensor, onTemp, offTemp) {}
+  bool isOn() const override { return bOn; }
+  void setOn(bool bOn) override { this->bOn = bOn; }
+  void setup() override {}
+};
+
+struct Switch : PowerSwitch {
+  bool bOn = false;
+  RTTI_GET_TYPE_IMPL(test,Switch)
+  Switch(const char* name) : PowerSwitch(name) {}
+  bool isOn() const override { return bOn; }
+  void setOn(bool bOn) override { this->bOn = bOn; }
+  void setup() override {}
+};
+
+SensorFn enclosureTempSensor("Enclosure Temp", enclosureTemp),
+         inverterTempSensor("Inverter Temp", inverterTemp),
+         bankVoltageSensor("Bank Voltage", bankVoltage);
+Fan enclosureFan("Enclosure Fan", enclosureTempSensor, 98, 95),
+    chargersFan("Chargers Fan", enclosureTempSensor, 110, 105),
+    inverterFan("Inverter Fan", inverterTempSensor, 103, 100);
+AtLeast<float,Sensor&> minSteady(24.5f, bankVoltageSensor), minDip(25.1f, bankVoltageSensor);
+AndConstraint outletConstraints({&minSteady, &minDip});
+NotConstraint notMinSteady(&minSteady);
+Switch outlets("Outlets"), inverter("Inverter");
+Devices devices({&enclosureFan, &chargersFan, &inverterFan, &outlets, &inverter});
+
+void setupDevices() {
+  enclosureFan.setPredictive(true);
+  outlets.setConstraint(&outletConstraints);
+  inverter.setConstraint(&notMinSteady);
+  for ( Device* pDevice : devices ) {
+    pDevice->applyConstraint();
+  }
+}
+
+// Same shape as the GET,DEVICES verbose response body in loop()
+void printDevicesResponse(JsonStreamWriter& w) {
+  w.println("[");
+  w.increaseDepth();
+  w.println("{");
+  w.printlnVectorObj(F("devices"), devices, ",", true);
+  w.println("}");
+  w.decreaseDepth();
+  w.print("]");
+}
+
+void testDevicesResponse() {
+  std::ifstream golden(GOLDEN_PATH);
+  std::stringstream expected;
+  expected << golden.rdbuf();
+  CHECK(expected.str().size() > 1000);
+
+  StringStreamPrinter printer;
+  unsigned long byteCnt, checksum;
+  {
+    JsonStreamWriter w(printer);
+    printDevicesResponse(w);
+    byteCnt = w.getByteCount();
+    checksum = w.getChecksum();
+  }
+  CHECK(printer.ss.str() == expected.str());
+  CHECK(byteCnt == expected.str().size());
+  CHECK(checksum == sumBytes(expected.str()));
+}
+
+struct CountingBuffer : std::streambuf {
+  unsigned long cnt = 0;
+  int overflow(int c) override { cnt++; return c; }
+  std::streamsize xsputn(const char*, std::streamsize n) override { cnt += n; return n; }
+};
+
+// Before StagingBuffer everything was formatted twice: once into a byte and checksum counter
+// (SerialByteCounter) and again to the output stream.  Rebuilt here as a counting pass of the whole
+// response followed by the pass to the printer.
+struct ByteCounter : std::streambuf {
+  unsigned long byteCnt = 0, checksum = 0;
+  int overflow(int c) override {
+    if ( c != EOF ) {
+      byteCnt++;
+      checksum += (uint8_t) c;
+    }
+    return c;
+  }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    for ( std::streamsize i = 0; i < n; i++ ) {
+      overflow((uint8_t) s[i]);
+    }
+    return n;
+  }
+};
+
+void printTwoPass(OutputStreamPrinter& printer, unsigned long& byteCnt, unsigned long& checksum) {
+  static ByteCounter counter;
+  static std::ostream os(&counter);
+  static OutputStreamPrinter countPrinter(&os);
+  counter.byteCnt = counter.checksum = 0;
+  {
+    JsonStreamWriter w(countPrinter);
+    printDevicesResponse(w);
+  }
+  byteCnt = counter.byteCnt;
+  checksum = counter.checksum;
+  JsonStreamWriter w(printer);
+  printDevicesResponse(w);
+}
+
+// Bytes per second writing the verbose devices response to a counting stream
+double benchmarkResponse(bool bTwoPass, unsigned long& bytesPerResponse) {
+  CountingBuffer buffer;
+  std::ostream os(&buffer);
+  OutputStreamPrinter printer(&os);
+  const int cnt = 20000;
+  unsigned long byteCnt, checksum;
+  double sec = host::timeSec([&]() {
+    for ( int i = 0; i < cnt; i++ ) {
+      if ( bTwoPass ) {
+        printTwoPass(printer, byteCnt, checksum);
+      } else {
+        JsonStreamWriter w(printer);
+        printDevicesResponse(w);
+      }
+    }
+  });
+  bytesPerResponse = buffer.cnt/cnt;
+  return buffer.cnt/sec;
+}
+
+void benchmark() {
+  // both paths must send and count the same response
+  StringStreamPrinter twoPassPrinter;
+  unsigned long byteCnt, checksum;
+  printTwoPass(twoPassPrinter, byteCnt, checksum);
+  std::ifstream golden(GOLDEN_PATH);
+  std::stringstream expected;
+  expected << golden.rdbuf();
+  CHECK(twoPassPrinter.ss.str() == expected.str());
+  CHECK(byteCnt == expected.str().size());
+  CHECK(checksum == sumBytes(expected.str()));
+
+  unsigned long twoPassBytes, stagedBytes;
+  double twoPassRate = benchmarkResponse(true, twoPassBytes);
+  double stagedRate = benchmarkResponse(false, stagedBytes);
+  CHECK(twoPassBytes == stagedBytes);
+  std::printf("  verbose devices response (%lu bytes): two-pass %.0f bytes/s, staged %.0f bytes/s, writer is %u bytes on this host\n",
+      stagedBytes, twoPassRate, stagedRate, (unsigned) sizeof(JsonStreamWriter));
+}
+
+int main(int argc, char** argv) {
+  setupDevices();
+  if ( argc > 1 && !strcmp(argv[1], "--write-golden") ) {
+    std::ofstream golden(GOLDEN_PATH);
+    OutputStreamPrinter printer(&golden);
+    JsonStreamWriter w(printer);
+    printDevicesResponse(w);
+    return 0;
+  }
+  testTokens();
+  testInterleavedWriters();
+  testImplPrintOrder();
+  testDevicesResponse();
+  benchmark();
+  return host::finish("JsonStreamWriterTest");
+}
@@ -0,0 +1,118 @@
+// LinearTrend sums must stay exact while samples are added, expired and the time base is moved forward:
+// after every step they are compared with sums recomputed from the samples in the ring.  The slope is
+// compared with a double precision least squares fit of the same samples.  3M samples with irregular
+// spacing, gaps longer than the window and millis() wrapping.  SlopeConstraint must have a valid trend
+// the first time it is tested since samples come from published sensor epochs.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/sensor/Sensor.h"
+#include "automation/sensor/LinearTrend.h"
+#include "automation/constraint/ValueConstraint.h"
+#include "automation/sensor/Sensor.cpp"
+#include "automation/constraint/Constraint.cpp"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace automation;
+
+struct CheckedTrend : LinearTrend {
+  unsigned long rebaseCnt = 0;
+
+  CheckedTrend(uint8_t capacity, unsigned long windowMs) : LinearTrend(capacity, windowMs) {}
+
+  bool add(float value, unsigned long timeMs) {
+    unsigned long lastBaseMs = baseMs;
+    bool bAdded = LinearTrend::add(value, timeMs);
+    if ( bAdded && count > 1 && baseMs != lastBaseMs ) {
+      rebaseCnt++;
+    }
+    return bAdded;
+  }
+
+  bool isExact() const {
+    int64_t t1 = 0, v1 = 0, tt = 0, tv = 0;
+    for ( uint8_t i = 0; i < count; i++ ) {
+      const Sample& s = samples[(first + i) % capacity];
+      int64_t t = toTicks(s.timeMs), v = s.value;
+      t1 += t;
+      v1 += v;
+      tt += t * t;
+      tv += t * v;
+    }
+    return t1 == sumT && v1 == sumV && tt == sumTT && tv == sumTV;
+  }
+
+  // Slope per minute fitted in double precision from the same (100ms tick, milli unit) samples
+  double referenceSlopePerMinute() const {
+    double n = count, st = 0, sv = 0, stt = 0, stv = 0;
+    for ( uint8_t i = 0; i < count; i++ ) {
+      const Sample& s = samples[(first + i) % capacity];
+      double t = (double) (toTicks(s.timeMs) - toTicks(samples[first].timeMs)) * TICK_MS / 60000.0;
+      double v = s.value / (double) SCALE;
+      st += t;
+      sv += v;
+      stt += t * t;
+      stv += t * v;
+    }
+    return (n * stv - st * sv) / (n * stt - st * st);
+  }
+};
+
+void testExactSums() {
+  CheckedTrend trend(12, 5*MINUTES);
+  unsigned long timeMs = 0xFFFFFFFFul - 20*MINUTES; // wraps during the run
+  srand(20);
+  const unsigned long cnt = 3000000;
+  unsigned long addedCnt = 0, inexactCnt = 0, slopeCnt = 0;
+  double maxSlopeError = 0;
+  for ( unsigned long i = 0; i < cnt; i++ ) {
+    timeMs += (i % 100000 == 99999) ? 10*MINUTES : 1000 + rand() % 60000; // occasional gap empties the window
+    float value = 100 * sin(i / 50.0) + (rand() % 2001 - 1000) / 10.0;
+    addedCnt += trend.add(value, timeMs);
+    if ( i % 7 == 0 ) {
+      trend.expire(timeMs + rand() % 30000);
+    }
+    if ( !trend.isExact() ) {
+      inexactCnt++;
+    }
+    if ( trend.isValid() ) {
+      double expected = trend.referenceSlopePerMinute();
+      double error = fabs(trend.getSlopePerMinute() - expected) / (fabs(expected) + 1);
+      maxSlopeError = error > maxSlopeError ? error : maxSlopeError;
+      slopeCnt++;
+    }
+  }
+  CHECK(inexactCnt == 0);
+  CHECK(addedCnt > cnt / 2);
+  CHECK(trend.rebaseCnt > 1000);
+  CHECK(slopeCnt > cnt / 2);
+  CHECK(maxSlopeError < 1e-5); // float division
+  std::printf("  %lu samples (%lu added, %lu rebases): %lu inexact sums, max relative slope error %.1e\n",
+      cnt, addedCnt, trend.rebaseCnt, inexactCnt, maxSlopeError);
+}
+
+float risingValue = 80;
+float getRisingValue() { return risingValue; }
+
+// Rises 1 per minute for 10 minutes of 15 second epochs before the slope is tested the first time
+void testSlopeFedByEpochs() {
+  SensorFn sensor("Rising", getRisingValue);
+  Sensors sensors({&sensor});
+  SlopeConstraint<float,Sensor&> slope(0.5, sensor);
+  for ( int i = 0; i < 40; i++ ) {
+    host::nowMs += 15*SECONDS;
+    risingValue += 0.25;
+    sensors.beginSampling();
+    CHECK(sensors.sampleTick());
+  }
+  CHECK(slope.test());
+  CHECK(fabs(slope.getSlopePerMinute() - 1) < 0.01);
+}
+
+int main() {
+  testExactSums();
+  testSlopeFedByEpochs();
+  return host::finish("LinearTrendTest");
+}
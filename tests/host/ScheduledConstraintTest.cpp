@@ -0,0 +1,138 @@
+// ScheduledConstraint caches its result until the next boundary.  nextTimeWithValue() must find the next
+// time a unit takes a value, wrapping to the next coarser unit when the value is not ahead, and
+// normalizing one past the end of a unit (range.second + 1).  updateNextBoundary() must pick the earliest
+// boundary of all units.  Range changes and clockChanged() make the cached result stale.  Times are UTC.
+
+#include "HostTest.h"
+#include "automation/Automation.h"
+#include "automation/constraint/ScheduledConstraint.h"
+#include "automation/constraint/Constraint.cpp"
+
+#include <cstdlib>
+#include <ctime>
+
+using namespace automation;
+
+struct Schedule : public ScheduledConstraint {
+  static const uint8_t MONTH = ScheduledConstraint::MONTH, MONTH_DAY = ScheduledConstraint::MONTH_DAY,
+      WEEK_DAY = ScheduledConstraint::WEEK_DAY, HOUR = ScheduledConstraint::HOUR;
+
+  using ScheduledConstraint::nextTimeWithValue;
+  using ScheduledConstraint::updateNextBoundary;
+
+  // Sets the time checked by the next calls
+  time_t at(int year, int month, int day, int hour, int minute, int second) {
+    checkTime = tmOf(year, month, day, hour, minute, second);
+    return mktime(&checkTime); // also sets tm_wday
+  }
+
+  time_t getNextBoundary() const { return bHaveNextBoundary ? nextBoundaryTime : 0; }
+
+  static struct tm tmOf(int year, int month, int day, int hour, int minute, int second) {
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_sec = second;
+    t.tm_isdst = -1;
+    return t;
+  }
+
+  static time_t timeOf(int year, int month, int day, int hour = 0, int minute = 0, int second = 0) {
+    struct tm t = tmOf(year, month, day, hour, minute, second);
+    return mktime(&t);
+  }
+};
+
+void testNextTimeWithValue() {
+  Schedule schedule;
+  schedule.at(2024, 3, 15, 10, 30, 45); // Friday
+
+  // hour ahead, hour wrapping to tomorrow, one past the last hour
+  CHECK(schedule.nextTimeWithValue(Schedule::HOUR, 12) == Schedule::timeOf(2024, 3, 15, 12));
+  CHECK(schedule.nextTimeWithValue(Schedule::HOUR, 8) == Schedule::timeOf(2024, 3, 16, 8));
+  CHECK(schedule.nextTimeWithValue(Schedule::HOUR, 10) == Schedule::timeOf(2024, 3, 16, 10));
+  CHECK(schedule.nextTimeWithValue(Schedule::HOUR, 24) == Schedule::timeOf(2024, 3, 16));
+
+  // week days (Sunday is 0) wrapping to next week and one past Saturday
+  CHECK(schedule.nextTimeWithValue(Schedule::WEEK_DAY, 6) == Schedule::timeOf(2024, 3, 16));
+  CHECK(schedule.nextTimeWithValue(Schedule::WEEK_DAY, 1) == Schedule::timeOf(2024, 3, 18));
+  CHECK(schedule.nextTimeWithValue(Schedule::WEEK_DAY, 5) == Schedule::timeOf(2024, 3, 22));
+  CHECK(schedule.nextTimeWithValue(Schedule::WEEK_DAY, 7) == Schedule::timeOf(2024, 3, 17));
+
+  // month days wrapping to next month and one past the 31st
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH_DAY, 20) == Schedule::timeOf(2024, 3, 20));
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH_DAY, 10) == Schedule::timeOf(2024, 4, 10));
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH_DAY, 32) == Schedule::timeOf(2024, 4, 1));
+
+  // months (0 based) wrapping to next year and one past December
+  schedule.at(2024, 12, 31, 23, 59, 59);
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH, 0) == Schedule::timeOf(2025, 1, 1));
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH, 12) == Schedule::timeOf(2025, 1, 1));
+  CHECK(schedule.nextTimeWithValue(Schedule::HOUR, 24) == Schedule::timeOf(2025, 1, 1));
+  CHECK(schedule.nextTimeWithValue(Schedule::MONTH_DAY, 1) == Schedule::timeOf(2025, 1, 1));
+}
+
+void testNextBoundary() {
+  Schedule schedule;
+  schedule.hours = {{8,17}};
+  schedule.weekDays = {{1,5}};
+
+  // Friday inside both ranges: the hour range ends first
+  schedule.updateNextBoundary(schedule.at(2024, 3, 15, 10, 30, 45));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 3, 15, 18));
+
+  // after the hours end the week day range ends at midnight (before the hours start again)
+  schedule.updateNextBoundary(schedule.at(2024, 3, 15, 18, 0, 0));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 3, 16));
+
+  // Sunday evening: week days start again at midnight
+  schedule.updateNextBoundary(schedule.at(2024, 3, 17, 20, 0, 0));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 3, 18));
+
+  // last hour of the day ends with the day (range.second + 1)
+  schedule.hours = {{20,23}};
+  schedule.weekDays.clear();
+  schedule.updateNextBoundary(schedule.at(2024, 3, 17, 22, 15, 0));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 3, 18));
+
+  // end of the last month day range of the month
+  schedule.hours.clear();
+  schedule.monthDays = {{1,15}, {25,31}};
+  schedule.updateNextBoundary(schedule.at(2024, 4, 28, 12, 0, 0));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 5, 1));
+  schedule.updateNextBoundary(schedule.at(2024, 4, 10, 12, 0, 0));
+  CHECK(schedule.getNextBoundary() == Schedule::timeOf(2024, 4, 16));
+}
+
+void testStale() {
+  Schedule schedule;
+  schedule.years = {{100, 300}}; // 2000 to 2200... no boundary soon
+  CHECK(schedule.checkRanges());
+  CHECK(schedule.isScheduleCurrent());
+
+  schedule.hours.push_back(Schedule::RangeVector::Range(0, 23));
+  CHECK(!schedule.isScheduleCurrent());
+  CHECK(schedule.checkRanges());
+  CHECK(schedule.isScheduleCurrent());
+
+  LocalTime::instance().clockChanged();
+  CHECK(!schedule.isScheduleCurrent());
+  CHECK(schedule.checkRanges());
+  CHECK(schedule.isScheduleCurrent());
+
+  schedule.years = {{0, 99}}; // before 2000
+  CHECK(!schedule.isScheduleCurrent());
+  CHECK(!schedule.checkRanges());
+}
+
+int main() {
+  setenv("TZ", "UTC", 1);
+  tzset();
+  testNextTimeWithValue();
+  testNextBoundary();
+  testStale();
+  return host::finish("ScheduledConstraintTest");
+}
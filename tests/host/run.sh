@@ -0,0 +1,14 @@
+#!/bin/sh
+# Build and run the host tests.  Only g++ is needed (no Arduino toolchain): ./tests/host/run.sh
+cd "$(dirname "$0")" || exit 1
+mkdir -p build
+status=0
+for src in *Test.cpp; do
+  name=${src%.cpp}
+  if g++ -std=gnu++11 -O2 -I../.. -o "build/$name" "$src"; then
+    "./build/$name" || status=1
+  else
+    status=1
+  fi
+done
+exit $status